@@ -69,16 +69,56 @@
 
 #include "read_from_rije_profile.h"
 #include "read_from_ke_profile.h"
+#include "profile_registry.h"
+#include "profile_shm.h"
+#include "recycle_inflow.h"
+#include "inflow_stream.h"
+#include "roughness_map.h"
 
 /*----------------------------------------------------------------------------*/
 
 BEGIN_C_DECLS
 
 #define Z0CABLE 0.001
-#define Z0SEABED 0.0001
-#define NUMOFLINES 120 //!!!! be carefull potential SIGSEV!!! should be less than numbers of lines in the file
-#define FILEPROFILE "tmpUx.csv"
-//#define FILEPROFILE "/home/konst/Projects/STHYF/Calcs/current-cylinder-bc/INIT/Ux.csv"
+#define SEABED_Z0_MAP "seabed_z0.map" //z0(x,z) raster, bottom is a rough wall if present
+
+//Recycling inflow: inlet values taken each step from a downstream plane
+#define RECYCLE_INFLOW 0              //1 to override the profile on RECYCLE_INLET
+#define RECYCLE_INLET "inlet"
+#define RECYCLE_SHIFT_X 1.0           //translation inlet -> recycling plane
+#define RECYCLE_SHIFT_Y 0.0
+#define RECYCLE_SHIFT_Z 0.0
+#define RECYCLE_SLAB 0.01             //half thickness of the donor cells layer
+#define RECYCLE_BULK_VELOCITY 0.0     //target bulk velocity, <=0 for no rescaling
+#define RECYCLE_Y_WALL 0.0            //wall position for thickness rescaling
+#define RECYCLE_THICKNESS_RATIO 1.0   //delta_plane/delta_inlet, 1 for none
+
+//Streaming inflow: profile frames from a producer process on the same node
+//(see inflow_producer.c), matched to the solver time each step
+#define INFLOW_STREAM 0               //1 to override the profile on INFLOW_STREAM_ZONE
+#define INFLOW_STREAM_NAME "/cs_inflow"
+#define INFLOW_STREAM_ZONE "inlet"
+#define INFLOW_STREAM_TIMEOUT 60.0    //s waiting for the producer
+
+/*============================================================================
+ * Static global variables
+ *============================================================================*/
+
+/* Per-face seabed roughness, sampled once */
+static cs_lnum_t _seabed_n_faces = -1;
+static cs_lnum_t *_seabed_face_ids = NULL;
+static cs_real_t *_seabed_z0 = NULL;
+
+/* Recycling map, built once */
+static struct recycle_inflow_t _recycle;
+static cs_real_t *_recycle_vals = NULL;
+static int _recycle_ready = 0;
+
+/* Streaming inflow, attached once */
+static struct inflow_stream_t _stream;
+static cs_lnum_t _stream_n_faces = -1;
+static cs_lnum_t *_stream_face_ids = NULL;
+
 /*=============================================================================
  * Public function definitions
  *============================================================================*/
@@ -115,19 +155,13 @@ cs_user_boundary_conditions(int         nvar,
   const cs_lnum_t n_b_faces = cs_glob_mesh->n_b_faces;
   const cs_real_3_t *b_face_normal
     = (const cs_real_3_t *) cs_glob_mesh_quantities->b_face_normal;
-  const cs_real_3_t  *restrict cell_cen
-    = (const cs_real_3_t *restrict)cs_glob_mesh_quantities->cell_cen;
   cs_lnum_t *lstelt = NULL;
   cs_lnum_t *face_list;
   cs_lnum_t  nelts;
-  cs_lnum_t  cell_id;
-  cs_field_t *f;
   cs_field_t *fu = CS_F_(u);
   const int keyvar = cs_field_key_id("variable_id");
 
   int ivar_Ux = cs_field_get_key_int(fu, keyvar) - 1 + 0;  //var for Ux
-  int ivar_Uy = cs_field_get_key_int(fu, keyvar) - 1 + 1;  //var for Uy
-  int ivar_Uz = cs_field_get_key_int(fu, keyvar) - 1 + 2;  //var for Uz
   //const int keyRough = cs_field_key_id("boundary_roughness");
 
   BFT_MALLOC(lstelt, n_b_faces, cs_lnum_t);
@@ -146,14 +180,41 @@ cs_user_boundary_conditions(int         nvar,
   //   cs_lnum_t face_id = lstelt[ilelt];
   //   bc_type[face_id] = CS_SYMMETRY;
   // }
-  // cs_selector_get_b_face_list("bottom", &nelts, lstelt);
-  // //int ivarv = cs_field_get_key_int(fu, keyvar) - 1; // access to U_x 
-  // for (cs_lnum_t ilelt = 0; ilelt < nelts; ilelt++) {
-  //   cs_lnum_t face_id = lstelt[ilelt];
-  //   bc_type[face_id] = CS_ROUGHWALL;
-  //   rcodcl[2*n_b_faces*nvar + ivar_Ux*n_b_faces + face_id] = Z0SEABED; //scalar roguhness
-  //   //rcodcl[2*n_b_faces*nvar + ivar_Uy*n_b_faces + face_id] = Z0SEABED; //roughness value z0
-  // }
+
+  //bottom: rough wall with z0 from the seabed raster (sampled at the first call)
+  if (_seabed_n_faces < 0) {
+    struct roughness_map_t z0_map;
+    _seabed_n_faces = 0;
+    if (roughness_map_open(SEABED_Z0_MAP, &z0_map) == EXIT_SUCCESS) {
+      const cs_real_t *b_face_cog = cs_glob_mesh_quantities->b_face_cog;
+      cs_real_t *xyz;
+
+      BFT_MALLOC(_seabed_face_ids, n_b_faces, cs_lnum_t);
+      cs_selector_get_b_face_list("bottom", &_seabed_n_faces, _seabed_face_ids);
+      BFT_MALLOC(_seabed_z0, _seabed_n_faces, cs_real_t);
+      BFT_MALLOC(xyz, 3*_seabed_n_faces, cs_real_t);
+      for (cs_lnum_t ilelt = 0; ilelt < _seabed_n_faces; ilelt++)
+        for (int j = 0; j < 3; j++)
+          xyz[3*ilelt + j] = b_face_cog[3*_seabed_face_ids[ilelt] + j];
+
+      if (roughness_map_sample(&z0_map, _seabed_n_faces, xyz, _seabed_z0)
+          != EXIT_SUCCESS)
+        bft_error(__FILE__, __LINE__, 0,
+                  "Error sampling seabed roughness map \"%s\".\n", SEABED_Z0_MAP);
+      roughness_map_close(&z0_map);
+      BFT_FREE(xyz);
+
+      //no data or non physical values: uniform seabed roughness
+      for (cs_lnum_t ilelt = 0; ilelt < _seabed_n_faces; ilelt++)
+        if (!(_seabed_z0[ilelt] > 0.))
+          _seabed_z0[ilelt] = Z0SEABED;
+    }
+  }
+  for (cs_lnum_t ilelt = 0; ilelt < _seabed_n_faces; ilelt++) {
+    cs_lnum_t face_id = _seabed_face_ids[ilelt];
+    bc_type[face_id] = CS_ROUGHWALL;
+    rcodcl[2*n_b_faces*nvar + ivar_Ux*n_b_faces + face_id] = _seabed_z0[ilelt]; //scalar roughness
+  }
 
   //for (cs_lnum_t ilelt = 0; ilelt < nelts; ilelt++) {
 //    cs_lnum_t face_id = lstelt[ilelt];
@@ -162,162 +223,156 @@ cs_user_boundary_conditions(int         nvar,
 //}
 
   ///////////PREPARE INLET BOUNDARIES
-
-  ////////prepare input files
-  //define file name of profile and length
-  size_t num_lines = NUMOFLINES; //number of points in profile defined by user in GUI
-  const char* fName = FILEPROFILE;
-
-  ///IF k-epsilon models
-  if( cs_glob_turb_model->itytur==2){///k-epsilon
-    //printf("k-epsilon\n");
-
-    cs_real_t *k = (cs_real_t *)(CS_F_(k)->val); 
-
-    //Prepare array for inital profiles
-    struct profile_keps_t* profile =
-                      (struct profile_keps_t *) malloc(sizeof(struct profile_keps_t)
-                      + num_lines*sizeof(struct record_keps_t));
-    profile->n_rows = num_lines;
-    profile->rec = (struct record_keps_t *) malloc ((profile->n_rows)*sizeof(struct record_keps_t));
-
-    //Read csv file
-    int status = read_profile_keps(fName, num_lines, profile);
-    if(status==EXIT_FAILURE){
-      printf("error of reading file\n");
-      return;
+  //profiles of all zones registered in cs_user_profiles.c,
+  //evaluated once and imposed in a single pass over their faces
+  profile_registry_apply(bc_type, icodcl, rcodcl);
+
+  ///////////RECYCLING INLET (overrides the profile on RECYCLE_INLET)
+  if (RECYCLE_INFLOW) {
+
+    if (!_recycle_ready) {
+      const cs_real_t shift[3] = {RECYCLE_SHIFT_X, RECYCLE_SHIFT_Y, RECYCLE_SHIFT_Z};
+      const cs_field_t *fields[3];
+      int scale_exp[3];
+      int n_fields = 0;
+
+      fields[n_fields] = CS_F_(u);   scale_exp[n_fields++] = 1;
+      if (cs_glob_turb_model->itytur==2) {
+        fields[n_fields] = CS_F_(k);   scale_exp[n_fields++] = 2;
+        fields[n_fields] = CS_F_(eps); scale_exp[n_fields++] = 3;
+      }
+      else if (cs_glob_turb_model->itytur==3) {
+        fields[n_fields] = CS_F_(rij); scale_exp[n_fields++] = 2;
+        fields[n_fields] = CS_F_(eps); scale_exp[n_fields++] = 3;
+      }
+
+      int status = recycle_inflow_setup(RECYCLE_INLET, shift, RECYCLE_SLAB,
+                                        RECYCLE_Y_WALL, RECYCLE_THICKNESS_RATIO,
+                                        n_fields, fields, scale_exp, &_recycle);
+      if (status==EXIT_FAILURE)
+        bft_error(__FILE__, __LINE__, 0,
+                  "Recycling inflow: cannot map \"%s\" faces.\n", RECYCLE_INLET);
+
+      _recycle.target_bulk = RECYCLE_BULK_VELOCITY;
+      BFT_MALLOC(_recycle_vals, _recycle.n_faces*_recycle.n_vals, cs_real_t);
+      _recycle_ready = 1;
     }
 
-    // Inlet
-    cs_real_t y_curr;
-    struct record_keps_t temp;
-    f = CS_F_(k);//get turbulence energy field
-    int ivar_k = cs_field_get_key_int(f, keyvar) - 1;  //ivar for k
-    
-    f = CS_F_(eps);//get turbulence energy field
-    int ivar_eps = cs_field_get_key_int(f, keyvar) - 1;  //ivar for eps
-
+    recycle_inflow_gather(&_recycle, _recycle_vals);
+    recycle_inflow_rescale(&_recycle, _recycle_vals);
 
-    cs_selector_get_b_face_list("inlet or outlet", &nelts, lstelt);
-    for (cs_lnum_t ilelt = 0; ilelt < nelts; ilelt++) {
-      cs_lnum_t face_id = lstelt[ilelt];
+    for (cs_lnum_t ilelt = 0; ilelt < _recycle.n_faces; ilelt++) {
+      cs_lnum_t face_id = _recycle.face_ids[ilelt];
+      const cs_real_t *vals = _recycle_vals + ilelt*_recycle.n_vals;
       bc_type[face_id] = CS_INLET;
-      cell_id = b_face_cells[face_id]; // associated boundary cell
-      
-      y_curr = cell_cen[cell_id][1]; // define height
-      temp = interpolate_keps(profile, y_curr);
-
-      //define Ux
-      icodcl[(ivar_Ux) * n_b_faces + face_id] = 1; //Dirihlet value
-      rcodcl[(ivar_Ux) * n_b_faces + face_id] = temp.u; //Value 
-
-      //define Uy
-      icodcl[(ivar_Uy) * n_b_faces + face_id] = 1; //Dirihlet value
-      rcodcl[(ivar_Uy) * n_b_faces + face_id] = temp.v; //Value  
-
-      //define Uz
-      icodcl[(ivar_Uz) * n_b_faces + face_id] = 1; //Dirihlet value
-      rcodcl[(ivar_Uz) * n_b_faces + face_id] = 0.; //Value  
-
-      //define k  
-      icodcl[(ivar_k) * n_b_faces + face_id] = 1; //Dirihlet value
-      rcodcl[(ivar_k) * n_b_faces + face_id] = temp.k; //Value  
-
-      //define eps
-      icodcl[(ivar_eps) * n_b_faces + face_id] = 1; //Dirihlet value
-      rcodcl[(ivar_eps) * n_b_faces + face_id] = temp.eps; //Value  
 
+      for (int f_id = 0; f_id < _recycle.n_fields; f_id++) {
+        const cs_field_t *fr = _recycle.fields[f_id];
+        int ivar = cs_field_get_key_int(fr, keyvar) - 1;
+        for (int j = 0; j < fr->dim; j++) {
+          icodcl[(ivar + j) * n_b_faces + face_id] = 1; //Dirihlet value
+          rcodcl[(ivar + j) * n_b_faces + face_id] = *vals++; //Value
+        }
+      }
     }
-    //Deallocate the memory
-    free(profile->rec);
-    free(profile);
-
   }
-  ///IF Rij-epsilon models (SSG,LRR,EBRSM)
-  else if( cs_glob_turb_model->itytur==3){//Rij-epsilon
-
-    //cs_real_6_t *rij = (cs_real_6_t *)(CS_F_(rij)->val); 
-
-    printf("SSG\n"); 
-    //Prepare array for inital profiles
-    struct profile_rijssg_t* profile =
-                      (struct profile_rijssg_t *) malloc(sizeof(struct profile_rijssg_t)
-                      + num_lines*sizeof(struct record_rijssg_t));;
-    profile->n_rows = num_lines;
-    profile->rec = (struct record_rijssg_t *) malloc ((profile->n_rows)*sizeof(struct record_rijssg_t));
-
-    //Read csv file
-    int status = read_profile_SSG(fName, num_lines, profile);
-    if(status==EXIT_FAILURE){
-      printf("error of reading file\n");
-      return;
-    }
 
-    // Inlet
-    cs_real_t y_curr;
-    struct record_rijssg_t temp;
-    f = CS_F_(rij);//get turbulence energy field
-    int ivar_R0 = cs_field_get_key_int(f, keyvar) - 1 + 0;  //var for R_xx
-  	int ivar_R1 = cs_field_get_key_int(f, keyvar) - 1 + 1;  //var for R_yy
-  	int ivar_R2 = cs_field_get_key_int(f, keyvar) - 1 + 2;  //var for R_zz
-  	int ivar_R3 = cs_field_get_key_int(f, keyvar) - 1 + 3;  //var for R_xy
-  	int ivar_R4 = cs_field_get_key_int(f, keyvar) - 1 + 4;  //var for R_yz
-  	int ivar_R5 = cs_field_get_key_int(f, keyvar) - 1 + 5;  //var for R_xz
-    
-    f = CS_F_(eps);//get turbulence energy field
-    int ivar_eps = cs_field_get_key_int(f, keyvar) - 1;  //ivar for eps
-
-    //Inlet or Outlet
-    cs_selector_get_b_face_list("inlet or outlet", &nelts, lstelt);
-    for (cs_lnum_t ilelt = 0; ilelt < nelts; ilelt++) {
-      cs_lnum_t face_id = lstelt[ilelt];
-      bc_type[face_id] = CS_INLET;
-      cell_id = b_face_cells[face_id]; // associated boundary cell
-      
-      y_curr = cell_cen[cell_id][1]; // define height
-      temp = interpolate_rijssg(profile, y_curr);
-
-      //define Ux
-      icodcl[(ivar_Ux) * n_b_faces + face_id] = 1; //Dirihlet value
-      rcodcl[(ivar_Ux) * n_b_faces + face_id] = temp.u; //Value 
-
-      //define Uy
-      icodcl[(ivar_Uy) * n_b_faces + face_id] = 1; //Dirihlet value
-      rcodcl[(ivar_Uy) * n_b_faces + face_id] = temp.v; //Value  
-
-      //define Uz
-      icodcl[(ivar_Uz) * n_b_faces + face_id] = 1; //Dirihlet value
-      rcodcl[(ivar_Uz) * n_b_faces + face_id] = 0.; //Value  
-
-      //define R_xx  
-      icodcl[(ivar_R0) * n_b_faces + face_id] = 1; //Dirihlet value
-      rcodcl[(ivar_R0) * n_b_faces + face_id] = temp.rxx; //Value  
-      //define R_yy  
-      icodcl[(ivar_R1) * n_b_faces + face_id] = 1; //Dirihlet value
-      rcodcl[(ivar_R1) * n_b_faces + face_id] = temp.ryy; //Value  
-      //define R_zz  
-      icodcl[(ivar_R2) * n_b_faces + face_id] = 1; //Dirihlet value
-      rcodcl[(ivar_R2) * n_b_faces + face_id] = temp.rzz; //Value  
-      //define R_xy
-      icodcl[(ivar_R3) * n_b_faces + face_id] = 1; //Dirihlet value
-      rcodcl[(ivar_R3) * n_b_faces + face_id] = temp.rxy; //Value  
-      //define R_yz  
-      icodcl[(ivar_R4) * n_b_faces + face_id] = 1; //Dirihlet value
-      rcodcl[(ivar_R4) * n_b_faces + face_id] = temp.ryz; //Value  
-      //define R_xz  
-      icodcl[(ivar_R5) * n_b_faces + face_id] = 1; //Dirihlet value
-      rcodcl[(ivar_R5) * n_b_faces + face_id] = temp.rxz; //Value  
-
-      //define eps
-      icodcl[(ivar_eps) * n_b_faces + face_id] = 1; //Dirihlet value
-      rcodcl[(ivar_eps) * n_b_faces + face_id] = temp.eps; //Value  
+  ///////////STREAMING INLET (overrides the profile on INFLOW_STREAM_ZONE)
+  if (INFLOW_STREAM) {
+    const cs_real_3_t *cell_cen
+      = (const cs_real_3_t *) cs_glob_mesh_quantities->cell_cen;
+    const cs_real_t t = cs_glob_time_step->t_cur;
+    int ivar_u = cs_field_get_key_int(CS_F_(u), keyvar) - 1;
+
+    if (_stream_n_faces < 0) {
+      if (cs_glob_turb_model->itytur != 2 && cs_glob_turb_model->itytur != 3)
+        bft_error(__FILE__, __LINE__, 0,
+                  "Inflow stream: k-epsilon or Rij-epsilon model required.\n");
+      if (inflow_stream_open(INFLOW_STREAM_NAME, INFLOW_STREAM_TIMEOUT, &_stream)
+          != EXIT_SUCCESS)
+        bft_error(__FILE__, __LINE__, 0,
+                  "Inflow stream \"%s\" not available.\n", INFLOW_STREAM_NAME);
+      BFT_MALLOC(_stream_face_ids, n_b_faces, cs_lnum_t);
+      cs_selector_get_b_face_list(INFLOW_STREAM_ZONE, &_stream_n_faces, _stream_face_ids);
+    }
 
+    if (cs_glob_turb_model->itytur==3) {
+      struct profile_rijssg_t rows;
+      int ivar_r = cs_field_get_key_int(CS_F_(rij), keyvar) - 1;
+      int ivar_eps = cs_field_get_key_int(CS_F_(eps), keyvar) - 1;
+      if (inflow_stream_advance_rijssg(&_stream, t, INFLOW_STREAM_TIMEOUT, &rows)
+          != EXIT_SUCCESS)
+        bft_error(__FILE__, __LINE__, 0,
+                  "Inflow stream: no frame for t = %g.\n", t);
+      for (cs_lnum_t ilelt = 0; ilelt < _stream_n_faces; ilelt++) {
+        cs_lnum_t face_id = _stream_face_ids[ilelt];
+        struct record_rijssg_t r
+          = interpolate_rijssg(&rows, cell_cen[b_face_cells[face_id]][1]);
+        const cs_real_t vals[10] = {r.u, r.v, 0., r.rxx, r.ryy, r.rzz,
+                                    r.rxy, r.ryz, r.rxz, r.eps};
+        bc_type[face_id] = CS_INLET;
+        for (int j = 0; j < 3; j++) {
+          icodcl[(ivar_u + j) * n_b_faces + face_id] = 1;
+          rcodcl[(ivar_u + j) * n_b_faces + face_id] = vals[j];
+        }
+        for (int j = 0; j < 6; j++) {
+          icodcl[(ivar_r + j) * n_b_faces + face_id] = 1;
+          rcodcl[(ivar_r + j) * n_b_faces + face_id] = vals[3 + j];
+        }
+        icodcl[ivar_eps * n_b_faces + face_id] = 1;
+        rcodcl[ivar_eps * n_b_faces + face_id] = vals[9];
+      }
+    }
+    else if (cs_glob_turb_model->itytur==2) {
+      struct profile_keps_t rows;
+      int ivar_k = cs_field_get_key_int(CS_F_(k), keyvar) - 1;
+      int ivar_eps = cs_field_get_key_int(CS_F_(eps), keyvar) - 1;
+      if (inflow_stream_advance_keps(&_stream, t, INFLOW_STREAM_TIMEOUT, &rows)
+          != EXIT_SUCCESS)
+        bft_error(__FILE__, __LINE__, 0,
+                  "Inflow stream: no frame for t = %g.\n", t);
+      for (cs_lnum_t ilelt = 0; ilelt < _stream_n_faces; ilelt++) {
+        cs_lnum_t face_id = _stream_face_ids[ilelt];
+        struct record_keps_t r
+          = interpolate_keps(&rows, cell_cen[b_face_cells[face_id]][1]);
+        bc_type[face_id] = CS_INLET;
+        icodcl[ivar_u * n_b_faces + face_id] = 1;
+        rcodcl[ivar_u * n_b_faces + face_id] = r.u;
+        icodcl[(ivar_u + 1) * n_b_faces + face_id] = 1;
+        rcodcl[(ivar_u + 1) * n_b_faces + face_id] = r.v;
+        icodcl[(ivar_u + 2) * n_b_faces + face_id] = 1;
+        rcodcl[(ivar_u + 2) * n_b_faces + face_id] = 0.;
+        icodcl[ivar_k * n_b_faces + face_id] = 1;
+        rcodcl[ivar_k * n_b_faces + face_id] = r.k;
+        icodcl[ivar_eps * n_b_faces + face_id] = 1;
+        rcodcl[ivar_eps * n_b_faces + face_id] = r.eps;
+      }
     }
-    //Deallocate the memory
-    free(profile->rec);
-    free(profile);
   }
 
+  //Release the cached profiles after the last time step
+  if (cs_glob_time_step->nt_cur >= cs_glob_time_step->nt_max)
+    profile_registry_finalize();
+  if (_seabed_n_faces >= 0
+      && cs_glob_time_step->nt_cur >= cs_glob_time_step->nt_max) {
+    BFT_FREE(_seabed_face_ids);
+    BFT_FREE(_seabed_z0);
+    _seabed_n_faces = -1;
+  }
+  if (_recycle_ready
+      && cs_glob_time_step->nt_cur >= cs_glob_time_step->nt_max) {
+    recycle_inflow_free(&_recycle);
+    BFT_FREE(_recycle_vals);
+    _recycle_ready = 0;
+  }
+  if (_stream_n_faces >= 0
+      && cs_glob_time_step->nt_cur >= cs_glob_time_step->nt_max) {
+    inflow_stream_close(&_stream);
+    BFT_FREE(_stream_face_ids);
+    _stream_n_faces = -1;
+  }
+  if (cs_glob_time_step->nt_cur >= cs_glob_time_step->nt_max)
+    profile_shm_finalize();
 
   BFT_FREE(lstelt);
 
@@ -0,0 +1,240 @@
+/*============================================================================
+ * General-purpose user-defined functions called at the end of each time step.
+ *============================================================================*/
+
+/* Code_Saturne version 5.2.0 */
+
+/*
+  This file is part of Code_Saturne, a general-purpose CFD tool.
+
+  Copyright (C) 1998-2018 EDF S.A.
+
+  This program is free software; you can redistribute it and/or modify it under
+  the terms of the GNU General Public License as published by the Free Software
+  Foundation; either version 2 of the License, or (at your option) any later
+  version.
+
+  This program is distributed in the hope that it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+  details.
+
+  You should have received a copy of the GNU General Public License along with
+  this program; if not, write to the Free Software Foundation, Inc., 51 Franklin
+  Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/*----------------------------------------------------------------------------*/
+
+#include "cs_defs.h"
+
+/*----------------------------------------------------------------------------
+ * Standard C library headers
+ *----------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/*----------------------------------------------------------------------------
+ * Local headers
+ *----------------------------------------------------------------------------*/
+
+#include "bft_mem.h"
+#include "bft_error.h"
+#include "bft_printf.h"
+
+#include "cs_base.h"
+#include "cs_restart.h"
+#include "cs_time_step.h"
+
+/*----------------------------------------------------------------------------
+ * Header for the current file
+ *----------------------------------------------------------------------------*/
+
+#include "cs_prototypes.h"
+
+#include "wake_probes.h"
+#include "profile_extract.h"
+#include "surface_pod.h"
+#include "phase_average.h"
+
+/*----------------------------------------------------------------------------*/
+
+BEGIN_C_DECLS
+
+//Wake probes (the cable force is written by cs_user_extra_operations.f90)
+#define PROBES_INTERVAL 0             //sampling period in time steps, 0 for none
+#define PROBES_WAKE_X0 0.1            //first wake line, downstream of the cable
+#define PROBES_WAKE_DX 0.1            //distance between wake lines
+#define PROBES_WAKE_LINES 5
+#define PROBES_WAKE_Y0 0.0            //vertical extent of the wake lines
+#define PROBES_WAKE_Y1 0.5
+#define PROBES_WAKE_Z 0.0             //spanwise position
+#define PROBES_LINE_POINTS 50
+#define PROBES_PLANE 1                //1 for a (x,y) sampling plane in the wake
+#define PROBES_PLANE_NX 40
+#define PROBES_PLANE_NY 20
+
+//Plane averaged vertical profile (precursor run), written in the layout
+//read by read_profile_keps()/read_profile_SSG()
+#define EXTRACT_INTERVAL 0            //sampling period in time steps, 0 for none
+#define EXTRACT_START 0               //time step from which the time average starts
+#define EXTRACT_WRITE 1000            //write period in time steps (and at the last step)
+#define EXTRACT_CELLS "all[]"
+#define EXTRACT_BINS 100
+#define EXTRACT_Y0 0.0                //EXTRACT_Y0 >= EXTRACT_Y1: extent of the cells
+#define EXTRACT_Y1 0.0
+#define EXTRACT_FILE "tmpUx.csv"
+#define EXTRACT_BINARY 0              //1 for a binary column file instead of CSV
+
+//Streaming POD of the pressure and shear on the cable faces (shear needs
+//the boundary_forces field, as for force.txt), no snapshot is stored
+#define POD_INTERVAL 0                //sampling period in time steps, 0 for none
+#define POD_ZONE "cable"
+#define POD_MODES 10                  //modes kept (<= SURFACE_POD_MAX_MODES)
+#define POD_PREFIX "pod_cable"        //pod_cable_sv.dat, _modes.dat, _coef.dat
+
+//Phase averaged fields, conditioned on the shedding phase of the cable lift
+//(needs the boundary_forces field); saved with the checkpoints and
+//postprocessed at the last time step as <field>_phase_<k>
+#define PHASE_BINS 0                  //number of phase bins, 0 for none
+#define PHASE_INTERVAL 1              //accumulation period in time steps
+#define PHASE_LIFT_ZONE "cable"
+#define PHASE_LIFT_DIR_X 0.0          //lift direction
+#define PHASE_LIFT_DIR_Y 1.0
+#define PHASE_LIFT_DIR_Z 0.0
+#define PHASE_CELLS "all[]"           //e.g. a wake box, to bound the memory
+
+/*============================================================================
+ * Static global variables
+ *============================================================================*/
+
+static int _probes_defined = 0;
+
+static struct profile_extract_t _extract;
+static int _extract_ready = 0;
+
+static struct surface_pod_t _pod;
+static int _pod_ready = 0;
+
+static struct phase_average_t _phase;
+static int _phase_ready = 0;
+
+/*=============================================================================
+ * Public function definitions
+ *============================================================================*/
+
+/*----------------------------------------------------------------------------*/
+/*!
+ * \brief This function is called at the end of each time step.
+ *
+ * It has a very general purpose, although it is recommended to handle
+ * mainly postprocessing or data-extraction type operations.
+ */
+/*----------------------------------------------------------------------------*/
+
+void
+cs_user_extra_operations(void)
+{
+  const cs_time_step_t *ts = cs_glob_time_step;
+
+  ///////////PLANE AVERAGED PROFILE
+  if (EXTRACT_INTERVAL > 0 && ts->nt_cur >= EXTRACT_START) {
+    const enum profile_extract_format_t format
+      = EXTRACT_BINARY ? PROFILE_EXTRACT_BINARY : PROFILE_EXTRACT_CSV;
+
+    if (!_extract_ready) {
+      if (profile_extract_setup(EXTRACT_CELLS, EXTRACT_Y0, EXTRACT_Y1,
+                                EXTRACT_BINS, &_extract) != EXIT_SUCCESS)
+        bft_error(__FILE__, __LINE__, 0,
+                  "Profile extraction: setup failed for \"%s\", see the log.\n",
+                  EXTRACT_CELLS);
+      _extract_ready = 1;
+    }
+
+    profile_extract_sample(&_extract, EXTRACT_INTERVAL);
+
+    const int last = (ts->nt_cur >= ts->nt_max);
+    if (last || (EXTRACT_WRITE > 0 && ts->nt_cur % EXTRACT_WRITE == 0))
+      profile_extract_write(&_extract, EXTRACT_FILE, format);
+    if (last) {
+      profile_extract_free(&_extract);
+      _extract_ready = 0;
+    }
+  }
+
+  ///////////MODAL DECOMPOSITION OF THE CABLE LOADS
+  if (POD_INTERVAL > 0) {
+    if (!_pod_ready) {
+      if (surface_pod_setup(POD_ZONE, POD_MODES, &_pod) != EXIT_SUCCESS)
+        bft_error(__FILE__, __LINE__, 0,
+                  "Surface POD: no face selected by \"%s\".\n", POD_ZONE);
+      _pod_ready = 1;
+    }
+
+    surface_pod_sample(&_pod, POD_INTERVAL);
+
+    if (ts->nt_cur >= ts->nt_max) {
+      surface_pod_write(&_pod, POD_PREFIX);
+      surface_pod_free(&_pod);
+      _pod_ready = 0;
+    }
+  }
+
+  ///////////PHASE AVERAGING
+  if (PHASE_BINS > 0) {
+    if (!_phase_ready) {
+      const cs_real_t dir[3] = {PHASE_LIFT_DIR_X, PHASE_LIFT_DIR_Y, PHASE_LIFT_DIR_Z};
+      if (phase_average_setup(PHASE_LIFT_ZONE, dir, PHASE_CELLS, PHASE_BINS,
+                              &_phase) != EXIT_SUCCESS)
+        bft_error(__FILE__, __LINE__, 0,
+                  "Phase average: setup failed on \"%s\".\n", PHASE_LIFT_ZONE);
+      _phase_ready = 1;
+    }
+
+    phase_average_sample(&_phase, PHASE_INTERVAL);
+
+    const int last = (ts->nt_cur >= ts->nt_max);
+    if (last || cs_restart_checkpoint_required(ts))
+      phase_average_checkpoint(&_phase);
+    if (last) {
+      phase_average_post(&_phase);
+      phase_average_free(&_phase);
+      _phase_ready = 0;
+    }
+  }
+
+  if (PROBES_INTERVAL <= 0)
+    return;
+
+  //probe sets, located at the first sampling
+  if (!_probes_defined) {
+    char name[32];
+    for (int l = 0; l < PROBES_WAKE_LINES; l++) {
+      const cs_real_t x = PROBES_WAKE_X0 + l*PROBES_WAKE_DX;
+      const cs_real_t a[3] = {x, PROBES_WAKE_Y0, PROBES_WAKE_Z};
+      const cs_real_t b[3] = {x, PROBES_WAKE_Y1, PROBES_WAKE_Z};
+      snprintf(name, sizeof(name), "wake_line_%d", l);
+      wake_probes_add_line(name, a, b, PROBES_LINE_POINTS);
+    }
+    if (PROBES_PLANE) {
+      const cs_real_t o[3] = {PROBES_WAKE_X0, PROBES_WAKE_Y0, PROBES_WAKE_Z};
+      const cs_real_t e1[3] = {(PROBES_WAKE_LINES - 1)*PROBES_WAKE_DX, 0., 0.};
+      const cs_real_t e2[3] = {0., PROBES_WAKE_Y1 - PROBES_WAKE_Y0, 0.};
+      wake_probes_add_plane("wake_plane", o, e1, e2,
+                            PROBES_PLANE_NX, PROBES_PLANE_NY);
+    }
+    _probes_defined = 1;
+  }
+
+  wake_probes_sample(PROBES_INTERVAL);
+
+  if (ts->nt_cur >= ts->nt_max) {
+    wake_probes_finalize();
+    _probes_defined = 0;
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+
+END_C_DECLS
@@ -82,16 +82,21 @@
 #include "cs_prototypes.h"
 #include "read_from_rije_profile.h"
 #include "read_from_ke_profile.h"
+#include "profile_registry.h"
+#include "volume_init.h"
 #include <stdlib.h>
 
 /*----------------------------------------------------------------------------*/
 
 BEGIN_C_DECLS
 
+//The initial profile (file or analytic) is defined in cs_user_profiles.c
 
-#define NUMOFLINES_INIT 120
-#define FILEPROFILE_INIT "tmpUx.csv"
-//#define FILEPROFILE_INIT "/home/konst/Projects/STHYF/Calcs/current-cylinder-bc/INIT/Ux.csv"
+//Initialization from a coarse 3D solution on another mesh (CSV with
+//x,y,z,u,v,w,k,eps or x,y,z,u,v,w,rxx,ryy,rzz,rxy,ryz,rxz,eps columns)
+#define VOLUME_INIT 0                 //1 to use it, the profile is the fallback
+#define VOLUME_INIT_FILE "init3d.csv"
+#define VOLUME_INIT_MARGIN 0.1        //donor points kept around each partition (m)
 /*----------------------------------------------------------------------------*/
 /*!
  * \file cs_user_initialization.c
@@ -123,11 +128,30 @@ void
 cs_user_initialization(void)
 {
 
-  //define file name of profile and length
-  //!!!! be carefull potential SIGSEV!!! should be less than numbers of lines in the file
-  size_t num_lines = NUMOFLINES_INIT; //number of points in profile defined by user in GUI
+  //3D donor solution interpolated on the cells
+  if (VOLUME_INIT) {
+    struct volume_init_t donor;
+    int status = volume_init_load(VOLUME_INIT_FILE, VOLUME_INIT_MARGIN, &donor);
+    if (status == EXIT_SUCCESS)
+      status = volume_init_apply(&donor);
+    volume_init_free(&donor);
+    //all ranks take the same path: the profile if it failed anywhere
+    int failed = (status != EXIT_SUCCESS);
+#if defined(HAVE_MPI)
+    if (cs_glob_n_ranks > 1)
+      MPI_Allreduce(MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_MAX, cs_glob_mpi_comm);
+#endif
+    if (!failed)
+      return;
+    bft_printf("error of reading file %s, using the initial profile\n", VOLUME_INIT_FILE);
+  }
 
-  const char* fName = FILEPROFILE_INIT;
+  //profile source chosen in cs_user_profiles_define()
+  int src = profile_registry_initial();
+  if (src < 0) {
+    printf("no initial profile defined\n");
+    return;
+  }
 
     // Define CS-variables
   const int location_id = CS_MESH_LOCATION_CELLS;
@@ -142,6 +166,11 @@ cs_user_initialization(void)
   const cs_real_3_t* xyz = (const cs_real_3_t *)cs_glob_mesh->vtx_coord;
 
   cs_real_t *eps = (cs_real_t *)(CS_F_(eps)->val);
+
+  cs_real_t *y_cell;
+  BFT_MALLOC(y_cell, n_elts, cs_real_t);
+  for (cs_lnum_t i = 0; i < n_elts; i++)
+    y_cell[i] = cell_cen[i][1];
  
   
   ///IF k-epsilon models
@@ -150,24 +179,20 @@ cs_user_initialization(void)
 
     cs_real_t *k = (cs_real_t *)(CS_F_(k)->val); 
 
-    //Prepare array for inital profiles
-    struct profile_keps_t* profile =
-                      (struct profile_keps_t *) malloc(sizeof(struct profile_keps_t)
-                      + num_lines*sizeof(struct record_keps_t));;
-    profile->n_rows = num_lines;
-    profile->rec = (struct record_keps_t *) malloc ((profile->n_rows)*sizeof(struct record_keps_t));
+    //Evaluate the profile at all cell heights at once
+    struct record_keps_t *profile;
+    BFT_MALLOC(profile, n_elts, struct record_keps_t);
 
-    //Read csv file
-    int status = read_profile_keps(fName, num_lines, profile);
+    int status = profile_registry_eval_keps(src, n_elts, y_cell, profile);
     if(status==EXIT_FAILURE){
       printf("error of reading file\n");
+      BFT_FREE(profile);
+      BFT_FREE(y_cell);
       return;
     }
-    cs_real_t y_curr;
     struct record_keps_t temp;
     for (cs_lnum_t i = 0; i < n_elts; i++) {
-      y_curr = cell_cen[i][1];
-      temp = interpolate_keps(profile, y_curr);
+      temp = profile[i];
       vel[i][0]=temp.u;
       vel[i][1]=temp.v;
       vel[i][2]=0.0;
@@ -176,8 +201,7 @@ cs_user_initialization(void)
       eps[i] = temp.eps;
     }
     //Deallocate the memory
-    free(profile->rec);
-    free(profile);
+    BFT_FREE(profile);
 
   }
   ///IF Rij-epsilon models (SSG,LRR,EBRSM)
@@ -186,24 +210,20 @@ cs_user_initialization(void)
     cs_real_6_t *rij = (cs_real_6_t *)(CS_F_(rij)->val); 
 
     printf("SSG\n"); 
-    //Prepare array for inital profiles
-    struct profile_rijssg_t* profile =
-                      (struct profile_rijssg_t *) malloc(sizeof(struct profile_rijssg_t)
-                      + num_lines*sizeof(struct record_rijssg_t));;
-    profile->n_rows = num_lines;
-    profile->rec = (struct record_rijssg_t *) malloc ((profile->n_rows)*sizeof(struct record_rijssg_t));
-
-    //Read csv file
-    int status = read_profile_SSG(fName, num_lines, profile);
+    //Evaluate the profile at all cell heights at once
+    struct record_rijssg_t *profile;
+    BFT_MALLOC(profile, n_elts, struct record_rijssg_t);
+
+    int status = profile_registry_eval_rijssg(src, n_elts, y_cell, profile);
     if(status==EXIT_FAILURE){
       printf("error of reading file\n");
+      BFT_FREE(profile);
+      BFT_FREE(y_cell);
       return;
     }
-    cs_real_t y_curr;
     struct record_rijssg_t temp;
     for (cs_lnum_t i = 0; i < n_elts; i++) {
-      y_curr = cell_cen[i][1];
-      temp = interpolate_rijssg(profile, y_curr);
+      temp = profile[i];
       vel[i][0]=temp.u;
       vel[i][1]=temp.v;
       vel[i][2]=0.0;
@@ -219,14 +239,14 @@ cs_user_initialization(void)
       rij[i][5] = temp.rxz;  //R_xz
     }
     //Deallocate the memory
-    free(profile->rec);
-    free(profile);
+    BFT_FREE(profile);
   }
   else{
     printf("Error!There is no user-defined initialization for that turbulence model!\n");
-    return;
   }
 
+  BFT_FREE(y_cell);
+
 
 }
 
@@ -0,0 +1,134 @@
+/*============================================================================
+ * User definition of the inflow profiles imposed on boundary zones.
+ *============================================================================*/
+
+/* Code_Saturne version 5.2.0 */
+
+/*
+  This file is part of Code_Saturne, a general-purpose CFD tool.
+
+  Copyright (C) 1998-2018 EDF S.A.
+
+  This program is free software; you can redistribute it and/or modify it under
+  the terms of the GNU General Public License as published by the Free Software
+  Foundation; either version 2 of the License, or (at your option) any later
+  version.
+
+  This program is distributed in the hope that it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+  details.
+
+  You should have received a copy of the GNU General Public License along with
+  this program; if not, write to the Free Software Foundation, Inc., 51 Franklin
+  Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/*----------------------------------------------------------------------------*/
+
+#include "cs_defs.h"
+
+/*----------------------------------------------------------------------------
+ *  Local headers
+ *----------------------------------------------------------------------------*/
+
+#include "bft_mem.h"
+#include "bft_error.h"
+#include "bft_printf.h"
+
+#include "cs_base.h"
+
+/*----------------------------------------------------------------------------
+ *  Header for the current file
+ *----------------------------------------------------------------------------*/
+
+#include "profile_registry.h"
+#include "roughness_map.h"
+
+/*----------------------------------------------------------------------------*/
+
+BEGIN_C_DECLS
+
+#define NUMOFLINES 120 //!!!! be carefull potential SIGSEV!!! should be less than numbers of lines in the file
+#define FILEPROFILE "tmpUx.csv"
+//#define FILEPROFILE "/home/konst/Projects/STHYF/Calcs/current-cylinder-bc/INIT/Ux.csv"
+#define NUMOFLINES_INIT 120
+#define FILEPROFILE_INIT "tmpUx.csv" //initial fields
+//#define FILEPROFILE_INIT "/home/konst/Projects/STHYF/Calcs/current-cylinder-bc/INIT/Ux.csv"
+
+//Analytic current profile instead of the files (no file I/O)
+#define ANALYTIC_PROFILE 0            //1 for a log law, 2 for a 1/7 power law
+#define U_STAR 0.05                   //friction velocity (log law)
+#define Z0_PROFILE Z0SEABED           //seabed roughness (roughness_map.h)
+#define Y_SEABED 0.0                  //seabed position
+#define U_REF 1.0                     //power law: velocity at D_REF above the seabed
+#define D_REF 1.0
+
+//Load-time simplification of dense profile files, 0 to keep all rows
+#define SIMPLIFY_TOL_U 0.0            //max interpolation error on u, v (m/s)
+#define SIMPLIFY_TOL_TURB 0.0         //on k or Rij (m2/s2)
+#define SIMPLIFY_TOL_EPS 0.0          //on eps (m2/s3)
+
+//Tidal modulation of the inlet profile: u x s(t), k x s_t^2, eps x s_t^3
+//with s_t = max(|s|, TIDAL_TURB_MIN)
+#define TIDAL_MODULATION 0            //1 to modulate the base profile
+#define TIDAL_MEAN 0.0                //residual current, relative to the base profile
+#define TIDAL_T0 0.0                  //solver time of zero phase (s)
+#define TIDAL_TURB_MIN 0.1            //min |s| for k, Rij, eps (background turbulence at slack water)
+
+/*----------------------------------------------------------------------------*/
+/*!
+ * \brief Define the profile sources and the boundary zones they drive.
+ *
+ * Called once, before the first evaluation of the profiles. Zones are
+ * cs_boundary_zone names or selection criteria; a file used by several
+ * zones is read only once.
+ */
+/*----------------------------------------------------------------------------*/
+
+void
+cs_user_profiles_define(void)
+{
+  int src, init;
+
+  if (ANALYTIC_PROFILE) {
+    struct profile_analytic_t p;
+    if (ANALYTIC_PROFILE == 2)
+      profile_analytic_power_law(U_REF, D_REF, 1./7., Z0_PROFILE, Y_SEABED, &p);
+    else
+      profile_analytic_log_law(U_STAR, Z0_PROFILE, Y_SEABED, &p);
+    src = init = profile_registry_add_analytic(&p);
+  }
+  else {
+    src = profile_registry_add_file(FILEPROFILE, NUMOFLINES);
+    init = profile_registry_add_file(FILEPROFILE_INIT, NUMOFLINES_INIT);
+    profile_registry_set_tolerance(src, SIMPLIFY_TOL_U, SIMPLIFY_TOL_TURB,
+                                   SIMPLIFY_TOL_EPS);
+    profile_registry_set_tolerance(init, SIMPLIFY_TOL_U, SIMPLIFY_TOL_TURB,
+                                   SIMPLIFY_TOL_EPS);
+  }
+  int zone = profile_registry_add_zone("inlet or outlet", src, PROFILE_INTERP_LINEAR);
+  profile_registry_set_initial(init);
+
+  if (TIDAL_MODULATION) {
+    //base profile = spring tide peak flood; s < 0 reverses the flow
+    struct tidal_modulation_t tide;
+    tidal_modulation_init(TIDAL_MEAN, TIDAL_T0, &tide);
+    tide.turb_min = TIDAL_TURB_MIN;
+    tidal_modulation_add(&tide, "M2", 0.80, TIDAL_PERIOD_M2, 0.);
+    tidal_modulation_add(&tide, "S2", 0.20, TIDAL_PERIOD_S2, 0.);
+    profile_registry_set_modulation(zone, &tide);
+  }
+
+  //Example: separate flood-tide / ebb-tide inlets and side inflows
+  // int flood = profile_registry_add_file("flood.csv", 200);
+  // int ebb = profile_registry_add_file("ebb.csv", 200);
+  // profile_registry_add_zone("inlet_flood", flood, PROFILE_INTERP_LINEAR);
+  // profile_registry_add_zone("inlet_ebb", ebb, PROFILE_INTERP_LINEAR);
+  // profile_registry_add_zone("side_left or side_right", flood,
+  //                           PROFILE_INTERP_NEAREST);
+}
+
+/*----------------------------------------------------------------------------*/
+
+END_C_DECLS
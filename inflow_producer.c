@@ -0,0 +1,163 @@
+/*
+* Stand-alone producer of an inflow ring (see inflow_ring.h), standing in
+* for a precursor solver: replays a profile file with a sinusoidal
+* modulation, one frame per time step, blocking when the solver lags.
+*
+*   cc -O2 -o inflow_producer inflow_producer.c read_from_ke_profile.c \
+*      read_from_rije_profile.c profile_columns.c -lm -lrt
+*   ./inflow_producer /cs_inflow tmpUx.csv 120 0.01 1000 slots=8 period=5 amplitude=0.2
+*
+* Options: slots (ring size), t0 (first time stamp), period and amplitude
+* of the modulation u x s, k and Rij x s^2, eps x |s|^3 with
+* s = 1 + amplitude sin(2 pi (t - t0)/period), model=keps|rij.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "inflow_ring.h"
+
+static const double _pi = 3.14159265358979323846;
+
+static void
+_pause(void)
+{
+    struct timespec ts = {0, 100000};
+    nanosleep(&ts, NULL);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 6) {
+        fprintf(stderr, "usage: %s name profile.csv num_lines dt n_steps"
+                " [slots=8] [t0=0] [period=0] [amplitude=0] [model=keps|rij]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const char *name = argv[1];
+    const char *fName = argv[2];
+    size_t num_lines = (size_t)atol(argv[3]);
+    double dt = atof(argv[4]);
+    long n_steps = atol(argv[5]);
+    unsigned n_slots = 8;
+    double t0 = 0., period = 0., amplitude = 0.;
+    uint32_t kind = INFLOW_RING_KEPS;
+
+    for (int i = 6; i < argc; i++) {
+        const char *eq = strchr(argv[i], '=');
+        if (eq == NULL) continue;
+        if (strncmp(argv[i], "slots=", 6) == 0)          n_slots = (unsigned)atoi(eq + 1);
+        else if (strncmp(argv[i], "t0=", 3) == 0)        t0 = atof(eq + 1);
+        else if (strncmp(argv[i], "period=", 7) == 0)    period = atof(eq + 1);
+        else if (strncmp(argv[i], "amplitude=", 10) == 0) amplitude = atof(eq + 1);
+        else if (strcmp(argv[i], "model=rij") == 0)      kind = INFLOW_RING_RIJSSG;
+        else fprintf(stderr, "unknown option \"%s\", ignored\n", argv[i]);
+    }
+    if (n_slots < 2)
+        n_slots = 2;
+
+    /* Base profile */
+    struct profile_keps_t keps;
+    struct profile_rijssg_t rij;
+    size_t n_rows;
+    int status;
+    if (kind == INFLOW_RING_RIJSSG) {
+        rij.rec = (struct record_rijssg_t *) malloc(num_lines*sizeof(struct record_rijssg_t));
+        status = read_profile_SSG(fName, num_lines, &rij);
+        n_rows = rij.n_rows;
+    }
+    else {
+        keps.rec = (struct record_keps_t *) malloc(num_lines*sizeof(struct record_keps_t));
+        status = read_profile_keps(fName, num_lines, &keps);
+        n_rows = keps.n_rows;
+    }
+    if (status != EXIT_SUCCESS || n_rows == 0) {
+        fprintf(stderr, "error of reading file %s\n", fName);
+        return EXIT_FAILURE;
+    }
+
+    /* Ring segment (a stale one from an interrupted run is replaced) */
+    const size_t frame_size = inflow_ring_frame_size(kind, n_rows);
+    const size_t size = inflow_ring_size(n_slots, frame_size);
+    shm_unlink(name);
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0 || ftruncate(fd, (off_t)size) != 0) {
+        fprintf(stderr, "cannot create shared memory segment %s\n", name);
+        return EXIT_FAILURE;
+    }
+    void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        shm_unlink(name);
+        return EXIT_FAILURE;
+    }
+
+    struct inflow_ring_header_t *hdr = (struct inflow_ring_header_t *)base;
+    memset(hdr, 0, sizeof(struct inflow_ring_header_t));
+    memcpy(hdr->magic, INFLOW_RING_MAGIC, 8);
+    hdr->kind = kind;
+    hdr->n_slots = n_slots;
+    hdr->n_rows = n_rows;
+    hdr->frame_size = frame_size;
+    __atomic_store_n(&(hdr->ready), 1, __ATOMIC_RELEASE);
+
+    printf("%s: %zu rows per frame, %u slots of %zu bytes\n", name, n_rows, n_slots, frame_size);
+
+    long step;
+    for (step = 0; step < n_steps; step++) {
+        const uint64_t head = hdr->head;
+
+        /* Backpressure: wait for a free slot */
+        while (   head - __atomic_load_n(&(hdr->tail), __ATOMIC_ACQUIRE) >= n_slots
+               && !__atomic_load_n(&(hdr->closed), __ATOMIC_ACQUIRE))
+            _pause();
+        if (__atomic_load_n(&(hdr->closed), __ATOMIC_ACQUIRE))
+            break;
+
+        struct inflow_frame_header_t *frame = inflow_ring_frame(base, head);
+        const double t = t0 + step*dt;
+        const double s = (period > 0.) ? 1. + amplitude*sin(2.*_pi*(t - t0)/period) : 1.;
+        const double s2 = s*s, s3 = fabs(s*s*s);
+
+        frame->t = t;
+        frame->step = (uint64_t)step;
+        if (kind == INFLOW_RING_RIJSSG) {
+            struct record_rijssg_t *r = (struct record_rijssg_t *) inflow_ring_records(frame);
+            for (size_t i = 0; i < n_rows; i++) {
+                r[i] = rij.rec[i];
+                r[i].u *= s;    r[i].v *= s;
+                r[i].rxx *= s2; r[i].ryy *= s2; r[i].rzz *= s2;
+                r[i].rxy *= s2; r[i].ryz *= s2; r[i].rxz *= s2;
+                r[i].eps *= s3;
+            }
+        }
+        else {
+            struct record_keps_t *r = (struct record_keps_t *) inflow_ring_records(frame);
+            for (size_t i = 0; i < n_rows; i++) {
+                r[i] = keps.rec[i];
+                r[i].u *= s; r[i].v *= s;
+                r[i].k *= s2;
+                r[i].eps *= s3;
+            }
+        }
+        __atomic_store_n(&(hdr->head), head + 1, __ATOMIC_RELEASE);
+    }
+
+    /* Keep the segment until the solver has detached */
+    __atomic_store_n(&(hdr->done), 1, __ATOMIC_RELEASE);
+    printf("%s: %ld frames published, waiting for the solver to detach\n", name, step);
+    while (!__atomic_load_n(&(hdr->closed), __ATOMIC_ACQUIRE))
+        _pause();
+
+    munmap(base, size);
+    shm_unlink(name);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,97 @@
+#ifndef INFLOW_RING_H
+#define INFLOW_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "read_from_ke_profile.h"
+#include "read_from_rije_profile.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+* Shared memory ring of inflow frames between a producer process
+* (inflow_producer, a precursor or a replay tool) and the solver ranks of
+* the same node. The producer creates the POSIX segment, publishes frame
+* i in slot i % n_slots and increments "head"; the consumer moves "tail"
+* to the oldest frame still in use. The producer waits while
+* head - tail == n_slots (bounded buffering, backpressure).
+*
+* Segment layout: header, then n_slots frames of frame_size bytes, each
+* one a frame header followed by n_rows profile records.
+*/
+
+#define INFLOW_RING_MAGIC "CSRING1"
+
+enum inflow_ring_kind_t {
+    INFLOW_RING_KEPS = 0,           /* struct record_keps_t */
+    INFLOW_RING_RIJSSG = 1          /* struct record_rijssg_t */
+};
+
+struct inflow_ring_header_t {
+    char magic[8];
+    uint32_t kind;
+    uint32_t n_slots;
+    uint64_t n_rows;                /* records per frame */
+    uint64_t frame_size;            /* bytes, multiple of 64 */
+    uint32_t ready;                 /* set last by the producer */
+    uint32_t done;                  /* producer finished, no more frames */
+    uint32_t closed;                /* consumer detached, producer may stop */
+    char pad0[20];
+    uint64_t head;                  /* frames published (own cache line) */
+    char pad1[56];
+    uint64_t tail;                  /* first frame still in use by the consumer */
+    char pad2[56];
+};
+
+struct inflow_frame_header_t {
+    double t;                       /* time stamp, compared to the solver time */
+    uint64_t step;
+    char pad[48];
+};
+
+
+static inline size_t
+inflow_ring_record_size(uint32_t kind)
+{
+    return (kind == INFLOW_RING_RIJSSG) ? sizeof(struct record_rijssg_t)
+                                        : sizeof(struct record_keps_t);
+}
+
+static inline size_t
+inflow_ring_frame_size(uint32_t kind, size_t n_rows)
+{
+    size_t s = sizeof(struct inflow_frame_header_t) + n_rows*inflow_ring_record_size(kind);
+    return (s + 63)/64*64;
+}
+
+static inline size_t
+inflow_ring_size(uint32_t n_slots, size_t frame_size)
+{
+    return sizeof(struct inflow_ring_header_t) + (size_t)n_slots*frame_size;
+}
+
+static inline struct inflow_frame_header_t *
+inflow_ring_frame(void *base, uint64_t i)
+{
+    struct inflow_ring_header_t *hdr = (struct inflow_ring_header_t *)base;
+    return (struct inflow_frame_header_t *)
+        ((char *)base + sizeof(struct inflow_ring_header_t)
+                      + (size_t)(i % hdr->n_slots)*hdr->frame_size);
+}
+
+static inline void *
+inflow_ring_records(struct inflow_frame_header_t *frame)
+{
+    return (char *)frame + sizeof(struct inflow_frame_header_t);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // INFLOW_RING_H
@@ -0,0 +1,255 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "cs_defs.h"
+
+#include "bft_mem.h"
+#include "bft_error.h"
+#include "bft_printf.h"
+
+#include "profile_shm.h"
+#include "inflow_stream.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define INFLOW_STREAM_POLL_NS 100000    /* 0.1 ms between two polls of the ring */
+
+
+static double
+_wtime(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + 1.e-9*(double)ts.tv_nsec;
+}
+
+static void
+_pause(void)
+{
+    struct timespec ts = {0, INFLOW_STREAM_POLL_NS};
+    nanosleep(&ts, NULL);
+}
+
+/* Map the segment once the producer has made it ready */
+static void *
+_attach(const char *name, int writable, double timeout, size_t *size)
+{
+    const double t0 = _wtime();
+
+    for (;;) {
+        int fd = shm_open(name, writable ? O_RDWR : O_RDONLY, 0);
+        if (fd >= 0) {
+            struct stat sb;
+            void *base = MAP_FAILED;
+            if (   fstat(fd, &sb) == 0
+                && (size_t)sb.st_size >= sizeof(struct inflow_ring_header_t))
+                base = mmap(NULL, (size_t)sb.st_size,
+                            writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                            MAP_SHARED, fd, 0);
+            close(fd);
+            if (base != MAP_FAILED) {
+                struct inflow_ring_header_t *hdr = (struct inflow_ring_header_t *)base;
+                if (   __atomic_load_n(&(hdr->ready), __ATOMIC_ACQUIRE)
+                    && memcmp(hdr->magic, INFLOW_RING_MAGIC, 8) == 0
+                    && inflow_ring_size(hdr->n_slots, hdr->frame_size)
+                       <= (size_t)sb.st_size) {
+                    *size = (size_t)sb.st_size;
+                    return base;
+                }
+                munmap(base, (size_t)sb.st_size);
+            }
+        }
+        if (_wtime() - t0 > timeout)
+            return NULL;
+        _pause();
+    }
+}
+
+/* Frame to use at time t (node root), NULL if none came in time */
+static struct inflow_frame_header_t *
+_select_frame(struct inflow_stream_t* st, double t, double timeout)
+{
+    struct inflow_ring_header_t *hdr = (struct inflow_ring_header_t *)st->base;
+    const double tol = 1.e-10 + 1.e-9*fabs(t);
+    const double t0 = _wtime();
+    uint64_t tail = hdr->tail;
+    uint64_t head;
+
+    /* Wait for a frame at or after t (or for the end of the stream).
+       Meanwhile the frames older than the newest one not after t go back
+       to the producer, which would otherwise block on a full ring of
+       frames all before t. */
+    for (;;) {
+        head = __atomic_load_n(&(hdr->head), __ATOMIC_ACQUIRE);
+        int done = __atomic_load_n(&(hdr->done), __ATOMIC_ACQUIRE);
+        uint64_t f = tail;
+        while (f + 1 < head && inflow_ring_frame(st->base, f + 1)->t <= t + tol)
+            f++;
+        if (f != tail) {
+            tail = f;
+            __atomic_store_n(&(hdr->tail), tail, __ATOMIC_RELEASE);
+        }
+        if (head > tail && (inflow_ring_frame(st->base, head - 1)->t >= t - tol || done))
+            break;
+        if (_wtime() - t0 > timeout || (done && head == tail))
+            return NULL;
+        _pause();
+    }
+
+    /* tail is now the newest frame not after t (or the first one) */
+    return inflow_ring_frame(st->base, tail);
+}
+
+static struct inflow_frame_header_t *
+_advance(struct inflow_stream_t* st, double t, double timeout)
+{
+    struct inflow_frame_header_t *frame = NULL;
+    uint64_t f[2] = {0, 0};     /* frame index, found */
+
+#if defined(HAVE_MPI)
+    /* The frame of the previous step is no longer read on this node */
+    if (st->node_comm != MPI_COMM_NULL)
+        MPI_Barrier(st->node_comm);
+#endif
+
+    if (st->is_root) {
+        frame = _select_frame(st, t, timeout);
+        if (frame != NULL) {
+            f[0] = ((struct inflow_ring_header_t *)st->base)->tail;
+            f[1] = 1;
+        }
+    }
+
+#if defined(HAVE_MPI)
+    if (st->node_comm != MPI_COMM_NULL) {
+        MPI_Bcast(f, 2, MPI_UINT64_T, 0, st->node_comm);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (!st->is_root && f[1])
+            frame = inflow_ring_frame(st->base, f[0]);
+    }
+#endif
+
+    if (!f[1])
+        return NULL;
+
+    st->frame = f[0];
+    st->t_frame = frame->t;
+    return frame;
+}
+
+
+int inflow_stream_open(const char *name, double timeout, struct inflow_stream_t* st)
+{
+    int ok = 1;
+
+    memset(st, 0, sizeof(struct inflow_stream_t));
+    st->is_root = 1;
+
+#if defined(HAVE_MPI)
+    st->node_comm = MPI_COMM_NULL;
+    if (cs_glob_n_ranks > 1) {
+        int node_rank;
+        st->node_comm = profile_shm_node_comm();
+        MPI_Comm_rank(st->node_comm, &node_rank);
+        st->is_root = (node_rank == 0);
+    }
+#endif
+
+    /* The node root waits for the producer, then the others attach */
+    if (st->is_root) {
+        st->base = _attach(name, 1, timeout, &(st->map_size));
+        ok = (st->base != NULL);
+    }
+#if defined(HAVE_MPI)
+    if (st->node_comm != MPI_COMM_NULL) {
+        MPI_Bcast(&ok, 1, MPI_INT, 0, st->node_comm);
+        if (ok && !st->is_root) {
+            st->base = _attach(name, 0, timeout, &(st->map_size));
+            ok = (st->base != NULL);
+        }
+    }
+    if (cs_glob_n_ranks > 1)
+        MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_MIN, cs_glob_mpi_comm);
+#endif
+
+    if (!ok) {
+        inflow_stream_close(st);
+        return EXIT_FAILURE;
+    }
+
+    const struct inflow_ring_header_t *hdr = (const struct inflow_ring_header_t *)st->base;
+    st->kind = hdr->kind;
+    st->n_rows = hdr->n_rows;
+
+    bft_printf("Inflow stream \"%s\": %lu rows per frame, %u slots.\n",
+               name, (unsigned long)st->n_rows, hdr->n_slots);
+    return EXIT_SUCCESS;
+}
+
+
+int inflow_stream_advance_keps(struct inflow_stream_t* st, double t, double timeout,
+                               struct profile_keps_t* rows)
+{
+    if (st->kind != INFLOW_RING_KEPS)
+        return EXIT_FAILURE;
+
+    struct inflow_frame_header_t *frame = _advance(st, t, timeout);
+    if (frame == NULL)
+        return EXIT_FAILURE;
+
+    rows->rec = (struct record_keps_t *) inflow_ring_records(frame);
+    rows->n_rows = st->n_rows;
+    return EXIT_SUCCESS;
+}
+
+
+int inflow_stream_advance_rijssg(struct inflow_stream_t* st, double t, double timeout,
+                                 struct profile_rijssg_t* rows)
+{
+    if (st->kind != INFLOW_RING_RIJSSG)
+        return EXIT_FAILURE;
+
+    struct inflow_frame_header_t *frame = _advance(st, t, timeout);
+    if (frame == NULL)
+        return EXIT_FAILURE;
+
+    rows->rec = (struct record_rijssg_t *) inflow_ring_records(frame);
+    rows->n_rows = st->n_rows;
+    return EXIT_SUCCESS;
+}
+
+
+void inflow_stream_close(struct inflow_stream_t* st)
+{
+#if defined(HAVE_MPI)
+    if (st->node_comm != MPI_COMM_NULL)
+        MPI_Barrier(st->node_comm);
+#endif
+    if (st->base != NULL) {
+        /* Release all frames and let the producer stop */
+        if (st->is_root) {
+            struct inflow_ring_header_t *hdr = (struct inflow_ring_header_t *)st->base;
+            __atomic_store_n(&(hdr->tail), __atomic_load_n(&(hdr->head), __ATOMIC_ACQUIRE),
+                             __ATOMIC_RELEASE);
+            __atomic_store_n(&(hdr->closed), 1, __ATOMIC_RELEASE);
+        }
+        munmap(st->base, st->map_size);
+    }
+    st->base = NULL;
+    st->map_size = 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
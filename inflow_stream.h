@@ -0,0 +1,59 @@
+#ifndef INFLOW_STREAM_H
+#define INFLOW_STREAM_H
+
+#include "cs_defs.h"
+
+#include "read_from_ke_profile.h"
+#include "read_from_rije_profile.h"
+#include "inflow_ring.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+* Consumer side of an inflow ring (see inflow_ring.h).
+* The node root maps the segment read-write and moves the tail, the other
+* ranks of the node map it read-only and get the frame index by broadcast.
+*/
+struct inflow_stream_t {
+    uint32_t kind;                  /* enum inflow_ring_kind_t */
+    size_t n_rows;
+    size_t map_size;
+    void *base;
+    int is_root;
+#if defined(HAVE_MPI)
+    MPI_Comm node_comm;
+#endif
+    uint64_t frame;                 /* frame in use */
+    double t_frame;
+};
+
+
+/**
+* Attach to the ring "name" (POSIX shm name, e.g. "/cs_inflow"), waiting
+* at most timeout seconds for the producer. Collective over all ranks.
+*/
+int inflow_stream_open(const char *name, double timeout, struct inflow_stream_t* st);
+
+/**
+* Select the newest frame with a time stamp <= t, waiting (at most
+* timeout seconds) until the producer has published a frame at or after
+* t, and release the older frames to the producer.
+* rows->rec points into the shared frame (no copy); it stays valid until
+* the next call. Collective over the ranks of the node.
+*/
+int inflow_stream_advance_keps(struct inflow_stream_t* st, double t, double timeout,
+                               struct profile_keps_t* rows);
+
+int inflow_stream_advance_rijssg(struct inflow_stream_t* st, double t, double timeout,
+                                 struct profile_rijssg_t* rows);
+
+void inflow_stream_close(struct inflow_stream_t* st);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // INFLOW_STREAM_H
@@ -0,0 +1,391 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <unistd.h>
+
+#include "cs_defs.h"
+
+#include "bft_mem.h"
+#include "bft_error.h"
+#include "bft_printf.h"
+
+#include "cs_field.h"
+#include "cs_field_pointer.h"
+#include "cs_mesh.h"
+#include "cs_mesh_quantities.h"
+#include "cs_post.h"
+#include "cs_restart.h"
+#include "cs_selector.h"
+#include "cs_time_step.h"
+#include "cs_turbulence_model.h"
+
+#include "phase_average.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PHASE_AVERAGE_RESTART "phase_average"
+#define PHASE_AVERAGE_N_TRACKER 10
+#define PHASE_AVERAGE_MIN_PERIOD 0.5    /* crossings closer than 0.5 x period are noise */
+
+
+/* Tracker state as a flat array, for the restart file */
+static void
+_tracker_pack(const struct phase_average_t* pa, cs_real_t v[])
+{
+    v[0] = pa->n_steps;    v[1] = pa->t_prev;   v[2] = pa->lift_prev;
+    v[3] = pa->lift_mean;  v[4] = pa->lift_int; v[5] = pa->t_cross;
+    v[6] = pa->period;     v[7] = pa->n_cross;  v[8] = pa->phase;
+    v[9] = pa->n_bins;
+}
+
+static void
+_tracker_unpack(struct phase_average_t* pa, const cs_real_t v[])
+{
+    pa->n_steps = (int)v[0];   pa->t_prev = v[1];   pa->lift_prev = v[2];
+    pa->lift_mean = v[3];      pa->lift_int = v[4]; pa->t_cross = v[5];
+    pa->period = v[6];         pa->n_cross = (int)v[7]; pa->phase = v[8];
+}
+
+static void
+_section_name(char *name, size_t len, const char *f_name, int bin)
+{
+    snprintf(name, len, "%s_phase_%02d", f_name, bin);
+}
+
+/* Global lift: boundary forces of the lift faces along lift_dir */
+static cs_real_t
+_lift(const struct phase_average_t* pa)
+{
+    const cs_field_t *f = cs_field_by_name("boundary_forces");
+    const cs_real_3_t *force = (const cs_real_3_t *) f->val;
+    cs_real_t lift = 0.;
+
+    for (cs_lnum_t i = 0; i < pa->n_lift_faces; i++) {
+        const cs_lnum_t face_id = pa->lift_face_ids[i];
+        lift +=   force[face_id][0]*pa->lift_dir[0]
+                + force[face_id][1]*pa->lift_dir[1]
+                + force[face_id][2]*pa->lift_dir[2];
+    }
+#if defined(HAVE_MPI)
+    if (cs_glob_n_ranks > 1)
+        MPI_Allreduce(MPI_IN_PLACE, &lift, 1, CS_MPI_REAL, MPI_SUM, cs_glob_mpi_comm);
+#endif
+    return lift;
+}
+
+/* Upward zero crossings of the lift minus its mean -> phase in [0, 1) */
+static void
+_track_phase(struct phase_average_t* pa, cs_real_t t, cs_real_t lift)
+{
+    if (pa->n_steps++ == 0) {
+        pa->t_prev = t;
+        pa->lift_prev = lift;
+        pa->lift_mean = lift;
+        pa->lift_int = 0.;
+        pa->t_cross = t;        /* start of the first mean */
+        pa->phase = -1.;
+        return;
+    }
+
+    const cs_real_t dt = t - pa->t_prev;
+    if (dt <= 0.)
+        return;
+    pa->lift_int += 0.5*(lift + pa->lift_prev)*dt;
+
+    const cs_real_t a = pa->lift_prev - pa->lift_mean;
+    const cs_real_t b = lift - pa->lift_mean;
+    if (a < 0. && b >= 0.) {
+        const cs_real_t tc = pa->t_prev + dt*(-a)/(b - a);
+        if (   pa->period <= 0.
+            || tc - pa->t_cross >= PHASE_AVERAGE_MIN_PERIOD*pa->period) {
+            /* Mean over the cycle just completed (or since the start) */
+            if (t > pa->t_cross)
+                pa->lift_mean = pa->lift_int/(t - pa->t_cross);
+            if (pa->n_cross > 0) {
+                pa->period = tc - pa->t_cross;
+                bft_printf("Phase average: shedding period %g at t = %g.\n",
+                           pa->period, tc);
+            }
+            pa->t_cross = tc;
+            pa->lift_int = 0.;
+            pa->n_cross++;
+        }
+    }
+    else if (pa->n_cross == 0 && t > pa->t_cross)
+        pa->lift_mean = pa->lift_int/(t - pa->t_cross);
+
+    pa->t_prev = t;
+    pa->lift_prev = lift;
+
+    pa->phase = -1.;
+    if (pa->period > 0.) {
+        const cs_real_t phase = (t - pa->t_cross)/pa->period;
+        if (phase >= 0. && phase < 1.)  /* beyond one period: crossing overdue */
+            pa->phase = phase;
+    }
+}
+
+/* Full cell array of one field and bin (zero outside the selection) */
+static void
+_expand(const struct phase_average_t* pa, int bin, int f_id, cs_real_t vals[])
+{
+    const int dim = pa->fields[f_id]->dim;
+    int shift = 0;
+    for (int j = 0; j < f_id; j++)
+        shift += pa->fields[j]->dim;
+
+    memset(vals, 0, cs_glob_mesh->n_cells*dim*sizeof(cs_real_t));
+    const cs_real_t *mean = pa->mean + (size_t)bin*pa->n_cells*pa->n_vals;
+    for (cs_lnum_t i = 0; i < pa->n_cells; i++)
+        for (int j = 0; j < dim; j++)
+            vals[pa->cell_ids[i]*dim + j] = mean[i*pa->n_vals + shift + j];
+}
+
+static void
+_restart_read(struct phase_average_t* pa)
+{
+    cs_real_t tracker[PHASE_AVERAGE_N_TRACKER];
+    cs_real_t *vals = NULL;
+    char name[128];
+    int ok = 1;
+
+    /* First run: no file (checked by one rank, the read is collective) */
+    int present = (   access("restart/" PHASE_AVERAGE_RESTART, R_OK) == 0
+                   || access("restart/" PHASE_AVERAGE_RESTART ".csc", R_OK) == 0);
+#if defined(HAVE_MPI)
+    if (cs_glob_n_ranks > 1)
+        MPI_Bcast(&present, 1, MPI_INT, 0, cs_glob_mpi_comm);
+#endif
+    if (!present)
+        return;
+
+    cs_restart_t *r = cs_restart_create(PHASE_AVERAGE_RESTART, NULL,
+                                        CS_RESTART_MODE_READ);
+    if (r == NULL)
+        return;
+
+    ok = (   cs_restart_read_section(r, "phase_average:tracker",
+                                     CS_RESTART_LOCATION_NONE,
+                                     PHASE_AVERAGE_N_TRACKER, CS_REAL_TYPE,
+                                     tracker) == CS_RESTART_SUCCESS
+          && (int)tracker[9] == pa->n_bins
+          && cs_restart_read_section(r, "phase_average:count",
+                                     CS_RESTART_LOCATION_NONE,
+                                     pa->n_bins, CS_INT_TYPE,
+                                     pa->count) == CS_RESTART_SUCCESS);
+
+    BFT_MALLOC(vals, cs_glob_mesh->n_cells*pa->n_vals, cs_real_t);
+    for (int bin = 0; ok && bin < pa->n_bins; bin++) {
+        cs_real_t *mean = pa->mean + (size_t)bin*pa->n_cells*pa->n_vals;
+        int shift = 0;
+        for (int f_id = 0; ok && f_id < pa->n_fields; f_id++) {
+            const int dim = pa->fields[f_id]->dim;
+            _section_name(name, sizeof(name), pa->fields[f_id]->name, bin);
+            ok = (cs_restart_read_section(r, name, CS_RESTART_LOCATION_CELL, dim,
+                                          CS_REAL_TYPE, vals) == CS_RESTART_SUCCESS);
+            for (cs_lnum_t i = 0; ok && i < pa->n_cells; i++)
+                for (int j = 0; j < dim; j++)
+                    mean[i*pa->n_vals + shift + j] = vals[pa->cell_ids[i]*dim + j];
+            shift += dim;
+        }
+    }
+    BFT_FREE(vals);
+    cs_restart_destroy(&r);
+
+    if (ok) {
+        _tracker_unpack(pa, tracker);
+        bft_printf("Phase average: statistics of %d cycles read back.\n", pa->n_cross);
+    }
+    else {
+        bft_printf("Phase average: restart data not compatible, statistics restarted.\n");
+        memset(pa->count, 0, sizeof(pa->count));
+        memset(pa->mean, 0, (size_t)pa->n_bins*pa->n_cells*pa->n_vals*sizeof(cs_real_t));
+    }
+}
+
+
+int phase_average_setup(const char *lift_criteria,
+                        const cs_real_t lift_dir[3],
+                        const char *cell_criteria,
+                        int n_bins,
+                        struct phase_average_t* pa)
+{
+    const cs_mesh_t *m = cs_glob_mesh;
+
+    memset(pa, 0, sizeof(struct phase_average_t));
+    if (n_bins < 1 || n_bins > PHASE_AVERAGE_MAX_BINS)
+        return EXIT_FAILURE;
+    if (cs_field_by_name_try("boundary_forces") == NULL) {
+        bft_printf("Phase average: the boundary_forces field is needed for the lift.\n");
+        return EXIT_FAILURE;
+    }
+
+    pa->n_bins = n_bins;
+    pa->phase = -1.;
+
+    const cs_real_t d = sqrt(  lift_dir[0]*lift_dir[0] + lift_dir[1]*lift_dir[1]
+                             + lift_dir[2]*lift_dir[2]);
+    if (d <= 0.)
+        return EXIT_FAILURE;
+    for (int j = 0; j < 3; j++)
+        pa->lift_dir[j] = lift_dir[j]/d;
+
+    BFT_MALLOC(pa->lift_face_ids, m->n_b_faces, cs_lnum_t);
+    cs_selector_get_b_face_list(lift_criteria, &(pa->n_lift_faces), pa->lift_face_ids);
+    BFT_REALLOC(pa->lift_face_ids, pa->n_lift_faces, cs_lnum_t);
+
+    BFT_MALLOC(pa->cell_ids, m->n_cells, cs_lnum_t);
+    cs_selector_get_cell_list(cell_criteria, &(pa->n_cells), pa->cell_ids);
+    BFT_REALLOC(pa->cell_ids, pa->n_cells, cs_lnum_t);
+
+    /* Velocity, pressure, then k and eps or Rij and eps */
+    pa->fields[pa->n_fields++] = CS_F_(u);
+    pa->fields[pa->n_fields++] = CS_F_(p);
+    if (cs_glob_turb_model->itytur == 2) {
+        pa->fields[pa->n_fields++] = CS_F_(k);
+        pa->fields[pa->n_fields++] = CS_F_(eps);
+    }
+    else if (cs_glob_turb_model->itytur == 3) {
+        pa->fields[pa->n_fields++] = CS_F_(rij);
+        pa->fields[pa->n_fields++] = CS_F_(eps);
+    }
+    for (int f_id = 0; f_id < pa->n_fields; f_id++)
+        pa->n_vals += pa->fields[f_id]->dim;
+
+    const size_t size = (size_t)n_bins*pa->n_cells*pa->n_vals;
+    BFT_MALLOC(pa->mean, size, cs_real_t);
+    memset(pa->mean, 0, size*sizeof(cs_real_t));
+
+    cs_gnum_t n_g[2] = {(cs_gnum_t)pa->n_lift_faces, (cs_gnum_t)pa->n_cells};
+#if defined(HAVE_MPI)
+    if (cs_glob_n_ranks > 1)
+        MPI_Allreduce(MPI_IN_PLACE, n_g, 2, CS_MPI_GNUM, MPI_SUM, cs_glob_mpi_comm);
+#endif
+    if (n_g[0] == 0) {
+        bft_printf("Phase average: no lift face selected by \"%s\".\n", lift_criteria);
+        phase_average_free(pa);
+        return EXIT_FAILURE;
+    }
+
+    bft_printf("Phase average: lift on %llu faces, %d bins of %llu cells"
+               " x %d values.\n",
+               (unsigned long long)n_g[0], n_bins, (unsigned long long)n_g[1],
+               pa->n_vals);
+
+    _restart_read(pa);
+    return EXIT_SUCCESS;
+}
+
+
+void phase_average_sample(struct phase_average_t* pa, int interval)
+{
+    const cs_time_step_t *ts = cs_glob_time_step;
+
+    if (pa->mean == NULL)
+        return;
+
+    _track_phase(pa, ts->t_cur, _lift(pa));
+
+    if (pa->phase < 0. || interval <= 0 || ts->nt_cur % interval != 0)
+        return;
+
+    int bin = (int)(pa->phase*pa->n_bins);
+    if (bin >= pa->n_bins)
+        bin = pa->n_bins - 1;
+
+    /* Running mean of the bin */
+    const cs_real_t a = 1./(++(pa->count[bin]));
+    cs_real_t *mean = pa->mean + (size_t)bin*pa->n_cells*pa->n_vals;
+    int shift = 0;
+    for (int f_id = 0; f_id < pa->n_fields; f_id++) {
+        const int dim = pa->fields[f_id]->dim;
+        const cs_real_t *val = pa->fields[f_id]->val;
+        for (cs_lnum_t i = 0; i < pa->n_cells; i++) {
+            const cs_real_t *v = val + pa->cell_ids[i]*dim;
+            cs_real_t *mi = mean + i*pa->n_vals + shift;
+            for (int j = 0; j < dim; j++)
+                mi[j] += a*(v[j] - mi[j]);
+        }
+        shift += dim;
+    }
+}
+
+
+void phase_average_checkpoint(const struct phase_average_t* pa)
+{
+    cs_real_t tracker[PHASE_AVERAGE_N_TRACKER];
+    cs_real_t *vals = NULL;
+    char name[128];
+
+    if (pa->mean == NULL)
+        return;
+
+    cs_restart_t *r = cs_restart_create(PHASE_AVERAGE_RESTART, NULL,
+                                        CS_RESTART_MODE_WRITE);
+
+    _tracker_pack(pa, tracker);
+    cs_restart_write_section(r, "phase_average:tracker", CS_RESTART_LOCATION_NONE,
+                             PHASE_AVERAGE_N_TRACKER, CS_REAL_TYPE, tracker);
+    cs_restart_write_section(r, "phase_average:count", CS_RESTART_LOCATION_NONE,
+                             pa->n_bins, CS_INT_TYPE, pa->count);
+
+    BFT_MALLOC(vals, cs_glob_mesh->n_cells*pa->n_vals, cs_real_t);
+    for (int bin = 0; bin < pa->n_bins; bin++) {
+        for (int f_id = 0; f_id < pa->n_fields; f_id++) {
+            _expand(pa, bin, f_id, vals);
+            _section_name(name, sizeof(name), pa->fields[f_id]->name, bin);
+            cs_restart_write_section(r, name, CS_RESTART_LOCATION_CELL,
+                                     pa->fields[f_id]->dim, CS_REAL_TYPE, vals);
+        }
+    }
+    BFT_FREE(vals);
+
+    cs_restart_destroy(&r);
+}
+
+
+void phase_average_post(const struct phase_average_t* pa)
+{
+    cs_real_t *vals = NULL;
+    char name[128];
+
+    if (pa->mean == NULL)
+        return;
+
+    cs_post_activate_writer(CS_POST_WRITER_ALL_ASSOCIATED, true);
+
+    BFT_MALLOC(vals, cs_glob_mesh->n_cells*pa->n_vals, cs_real_t);
+    for (int bin = 0; bin < pa->n_bins; bin++) {
+        for (int f_id = 0; f_id < pa->n_fields; f_id++) {
+            _expand(pa, bin, f_id, vals);
+            _section_name(name, sizeof(name), pa->fields[f_id]->name, bin);
+            cs_post_write_var(CS_POST_MESH_VOLUME, CS_POST_WRITER_ALL_ASSOCIATED,
+                              name, pa->fields[f_id]->dim, true, true,
+                              CS_REAL_TYPE, vals, NULL, NULL, cs_glob_time_step);
+        }
+    }
+    BFT_FREE(vals);
+
+    bft_printf("Phase average: %d bins written (samples per bin:", pa->n_bins);
+    for (int bin = 0; bin < pa->n_bins; bin++)
+        bft_printf(" %d", pa->count[bin]);
+    bft_printf(").\n");
+}
+
+
+void phase_average_free(struct phase_average_t* pa)
+{
+    BFT_FREE(pa->lift_face_ids);
+    BFT_FREE(pa->cell_ids);
+    BFT_FREE(pa->mean);
+    memset(pa, 0, sizeof(struct phase_average_t));
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,92 @@
+#ifndef PHASE_AVERAGE_H
+#define PHASE_AVERAGE_H
+
+#include "cs_defs.h"
+#include "cs_field.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PHASE_AVERAGE_MAX_FIELDS 4
+#define PHASE_AVERAGE_MAX_BINS 64
+
+
+/**
+* Phase averaged statistics conditioned on the vortex shedding phase.
+*
+* The phase is estimated from the lift on a set of boundary faces (sum of
+* the "boundary_forces" field along lift_dir): upward zero crossings of
+* the lift, minus its mean over the last period, are interpolated between
+* time steps, and the phase is the time since the last crossing divided
+* by the last period. The fields (velocity, pressure, then k and eps or
+* Rij and eps) of the selected cells are accumulated into n_bins running
+* means, stored for the selected cells only.
+*/
+struct phase_average_t {
+    int n_bins;
+
+    /* Lift and phase tracking (same values on all ranks) */
+    cs_lnum_t n_lift_faces;
+    cs_lnum_t *lift_face_ids;
+    cs_real_t lift_dir[3];
+    int n_steps;                /* lift samples seen */
+    cs_real_t t_prev, lift_prev;    /* previous sample */
+    cs_real_t lift_mean;        /* mean over the last period */
+    cs_real_t lift_int;         /* lift integral since the last crossing */
+    cs_real_t t_cross;          /* last upward crossing */
+    cs_real_t period;           /* last period, <= 0 while unknown */
+    int n_cross;
+    cs_real_t phase;            /* in [0, 1), < 0 if unknown */
+
+    /* Statistics on the selected cells */
+    cs_lnum_t n_cells;
+    cs_lnum_t *cell_ids;
+    int n_fields;
+    const cs_field_t *fields[PHASE_AVERAGE_MAX_FIELDS];
+    int n_vals;                 /* sum of the field dimensions */
+    int count[PHASE_AVERAGE_MAX_BINS];
+    cs_real_t *mean;            /* n_bins x n_cells x n_vals */
+};
+
+
+/**
+* Setup: lift from the faces of lift_criteria (e.g. "cable") along
+* lift_dir, statistics on the cells of cell_criteria (e.g. a wake box,
+* "all[]" for the whole domain) in n_bins phase bins.
+* The statistics of a previous run are read back from the restart
+* directory if present.
+*/
+int phase_average_setup(const char *lift_criteria,
+                        const cs_real_t lift_dir[3],
+                        const char *cell_criteria,
+                        int n_bins,
+                        struct phase_average_t* pa);
+
+/**
+* Update the phase from the current lift (every time step), and add the
+* fields to the bin of the current phase every "interval" time steps.
+* Collective.
+*/
+void phase_average_sample(struct phase_average_t* pa, int interval);
+
+/**
+* Save the statistics and the phase tracker to the "phase_average"
+* file of the checkpoint directory.
+*/
+void phase_average_checkpoint(const struct phase_average_t* pa);
+
+/**
+* Output the bin means as postprocessing fields <field>_phase_<k> on the
+* volume mesh (zero outside the selected cells).
+*/
+void phase_average_post(const struct phase_average_t* pa);
+
+void phase_average_free(struct phase_average_t* pa);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PHASE_AVERAGE_H
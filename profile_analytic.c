@@ -0,0 +1,146 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "cs_defs.h"
+
+#include "cs_turbulence_model.h"
+
+#include "profile_analytic.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ANALYTIC_BLOCK 256      /* heights evaluated together */
+
+/* Open channel log layer, Nezu & Nakagawa (1993) */
+static const double _rij_log_layer[6] = {2.30*2.30, 1.27*1.27, 1.63*1.63,
+                                         -1., 0., 0.};
+
+
+static void
+_defaults(double z0, double y_wall, struct profile_analytic_t* p)
+{
+    memset(p, 0, sizeof(struct profile_analytic_t));
+    p->y_wall = y_wall;
+    p->z0 = (z0 > 0.) ? z0 : 1.e-6;
+    p->kappa = cs_turb_xkappa;
+    p->cmu = cs_turb_cmu;
+    for (int j = 0; j < 6; j++)
+        p->rij[j] = _rij_log_layer[j];
+}
+
+/* Streamwise velocity and d + z0 for a block of heights */
+static void
+_eval_block(const struct profile_analytic_t* p, size_t n, const double y[],
+            double u[], double dz[])
+{
+    const double d_max = (p->depth > 0.) ? p->depth : HUGE_VAL;
+
+    for (size_t i = 0; i < n; i++) {
+        double d = y[i] - p->y_wall;
+        d = (d < 0.) ? 0. : ((d > d_max) ? d_max : d);
+        dz[i] = d + p->z0;
+    }
+
+    if (p->family == PROFILE_ANALYTIC_POWER_LAW) {
+        const double a = p->u_ref/pow(p->d_ref, p->alpha);
+        for (size_t i = 0; i < n; i++)
+            u[i] = a*pow(dz[i] - p->z0, p->alpha);
+    }
+    else {
+        const double a = p->u_star/p->kappa;
+        const double b = 1./p->z0;
+        for (size_t i = 0; i < n; i++)
+            u[i] = a*log(dz[i]*b);
+    }
+}
+
+
+void profile_analytic_log_law(double u_star,
+                              double z0,
+                              double y_wall,
+                              struct profile_analytic_t* p)
+{
+    _defaults(z0, y_wall, p);
+    p->family = PROFILE_ANALYTIC_LOG_LAW;
+    p->u_star = u_star;
+}
+
+
+void profile_analytic_power_law(double u_ref,
+                                double d_ref,
+                                double alpha,
+                                double z0,
+                                double y_wall,
+                                struct profile_analytic_t* p)
+{
+    _defaults(z0, y_wall, p);
+    p->family = PROFILE_ANALYTIC_POWER_LAW;
+    p->u_ref = u_ref;
+    p->d_ref = (d_ref > 0.) ? d_ref : 1.;
+    p->alpha = (alpha > 0.) ? alpha : 1./7.;
+    p->u_star = p->kappa*u_ref/log((p->d_ref + p->z0)/p->z0);
+}
+
+
+void profile_analytic_eval_keps(const struct profile_analytic_t* p,
+                                size_t n,
+                                const double y[],
+                                struct record_keps_t out[])
+{
+    const double k = p->u_star*p->u_star/sqrt(p->cmu);
+    const double e = p->u_star*p->u_star*p->u_star/p->kappa;
+    double u[ANALYTIC_BLOCK], dz[ANALYTIC_BLOCK];
+
+    for (size_t s = 0; s < n; s += ANALYTIC_BLOCK) {
+        size_t n_b = (n - s < ANALYTIC_BLOCK) ? n - s : ANALYTIC_BLOCK;
+        _eval_block(p, n_b, y + s, u, dz);
+        for (size_t i = 0; i < n_b; i++) {
+            struct record_keps_t *r = out + s + i;
+            r->y = y[s+i];
+            r->u = u[i];
+            r->v = 0.;
+            r->k = k;
+            r->eps = e/dz[i];
+        }
+    }
+}
+
+
+void profile_analytic_eval_rijssg(const struct profile_analytic_t* p,
+                                  size_t n,
+                                  const double y[],
+                                  struct record_rijssg_t out[])
+{
+    const double u2 = p->u_star*p->u_star;
+    const double e = u2*p->u_star/p->kappa;
+    const double tr = p->rij[0] + p->rij[1] + p->rij[2];
+    /* Normal stresses with a trace of 2k = 2 u*^2/sqrt(cmu) */
+    const double d2 = (tr > 0.) ? 2.*u2/(sqrt(p->cmu)*tr) : u2;
+    double u[ANALYTIC_BLOCK], dz[ANALYTIC_BLOCK];
+
+    for (size_t s = 0; s < n; s += ANALYTIC_BLOCK) {
+        size_t n_b = (n - s < ANALYTIC_BLOCK) ? n - s : ANALYTIC_BLOCK;
+        _eval_block(p, n_b, y + s, u, dz);
+        for (size_t i = 0; i < n_b; i++) {
+            struct record_rijssg_t *r = out + s + i;
+            r->y = y[s+i];
+            r->u = u[i];
+            r->v = 0.;
+            r->rxx = p->rij[0]*d2;
+            r->ryy = p->rij[1]*d2;
+            r->rzz = p->rij[2]*d2;
+            r->rxy = p->rij[3]*u2;
+            r->ryz = p->rij[4]*u2;
+            r->rxz = p->rij[5]*u2;
+            r->eps = e/dz[i];
+        }
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
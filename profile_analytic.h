@@ -0,0 +1,85 @@
+#ifndef PROFILE_ANALYTIC_H
+#define PROFILE_ANALYTIC_H
+
+#include "cs_defs.h"
+
+#include "read_from_ke_profile.h"
+#include "read_from_rije_profile.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/* Closed-form current profiles, d = y - y_wall is the height above the seabed */
+enum profile_analytic_family_t {
+    PROFILE_ANALYTIC_LOG_LAW,       /* u = u_star/kappa ln((d + z0)/z0) */
+    PROFILE_ANALYTIC_POWER_LAW      /* u = u_ref (d/d_ref)^alpha, alpha = 1/7 */
+};
+
+
+/**
+* Parameters of an analytic profile.
+* Turbulence is in local equilibrium with the friction velocity u*:
+* k = u*^2/sqrt(cmu), eps = u*^3/(kappa (d + z0)), and Rij = rij[] u*^2
+* with the diagonal of rij[] rescaled so that Rxx + Ryy + Rzz = 2k: rij[]
+* gives the anisotropy of the normal stresses, the shear stresses are
+* taken as they are.
+*/
+struct profile_analytic_t {
+    enum profile_analytic_family_t family;
+    double y_wall;          /* seabed position */
+    double depth;           /* values are constant above y_wall + depth, <= 0 for none */
+    double u_star;          /* friction velocity */
+    double z0;              /* roughness length */
+    double u_ref;           /* power law: velocity at the reference height d_ref */
+    double d_ref;
+    double alpha;
+    double kappa;
+    double cmu;
+    double rij[6];          /* Rij/u*^2: xx, yy, zz, xy, yz, xz (y vertical) */
+};
+
+
+/**
+* Log law over a rough seabed. The Reynolds stresses default to the
+* open channel log layer values of Nezu & Nakagawa:
+* sqrt(Rxx), sqrt(Ryy), sqrt(Rzz) = 2.30, 1.27, 1.63 u*, Rxy = -u*^2.
+* Their trace (9.56 u*^2) is larger than 2k = 6.67 u*^2 (cmu = 0.09), so
+* the normal stresses are scaled by 0.70 to stay consistent with k-eps.
+*/
+void profile_analytic_log_law(double u_star,
+                              double z0,
+                              double y_wall,
+                              struct profile_analytic_t* p);
+
+/**
+* Power law u_ref (d/d_ref)^alpha (alpha = 1/7 if <= 0); the friction
+* velocity used for k, eps and Rij matches the log law at d_ref.
+*/
+void profile_analytic_power_law(double u_ref,
+                                double d_ref,
+                                double alpha,
+                                double z0,
+                                double y_wall,
+                                struct profile_analytic_t* p);
+
+/**
+* Evaluate the profile at n heights y, same records as the table profiles.
+*/
+void profile_analytic_eval_keps(const struct profile_analytic_t* p,
+                                size_t n,
+                                const double y[],
+                                struct record_keps_t out[]);
+
+void profile_analytic_eval_rijssg(const struct profile_analytic_t* p,
+                                  size_t n,
+                                  const double y[],
+                                  struct record_rijssg_t out[]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PROFILE_ANALYTIC_H
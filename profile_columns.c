@@ -0,0 +1,964 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+#include "profile_columns.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+* Binary layout (native byte order):
+*   char     magic[8]               "CSPROF1"
+*   uint64   n_rows
+*   uint32   n_cols, chunk_rows
+*   n_cols x { char name[16]; uint32 encoding; uint32 pad; }
+*   then for each chunk of chunk_rows rows, for each column:
+*   uint32   rice parameter (0 for raw encodings, 0xffffffff for a
+*            delta column chunk stored raw because coding would not pay)
+*   uint32   n_bytes
+*   uint8    payload[n_bytes]
+*/
+
+static const char _magic[8] = "CSPROF1";
+
+#define RICE_ESCAPE 32      /* unary prefix length announcing a raw value */
+#define PROFILE_COL_RAW_CHUNK 0xffffffffu
+#define PROFILE_COL_MAX_COLS 4096  /* sanity bound on the header of a file */
+
+/* Positions used by read_profile_keps()/read_profile_SSG() when the
+   column names of a file are not the expected ones */
+static const char *_keps_names[] = {"y", "u", "v", "k", "eps"};
+static const int _keps_pos[] = {2, 4, 5, 6, 7};
+static const char *_rij_names[] = {"y", "u", "v", "rxx", "ryy", "rzz",
+                                   "rxy", "ryz", "rxz", "eps"};
+static const int _rij_pos[] = {2, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+
+/*----------------------------------------------------------------------------
+ * Bit streams
+ *----------------------------------------------------------------------------*/
+
+struct _bit_writer_t {
+    unsigned char *buf;
+    size_t n_bytes, capacity;
+    uint64_t acc;
+    int n_bits;
+};
+
+struct _bit_reader_t {
+    const unsigned char *buf;
+    size_t pos, n_bytes;
+    uint64_t acc;
+    int n_bits;
+};
+
+static void
+_bw_put(struct _bit_writer_t* w, uint64_t v, int n)   /* n <= 32 */
+{
+    if (n == 0)
+        return;
+    w->acc |= (v & ((UINT64_C(1) << n) - 1)) << w->n_bits;
+    w->n_bits += n;
+    while (w->n_bits >= 8) {
+        if (w->n_bytes == w->capacity) {
+            w->capacity = 2*w->capacity + 64;
+            w->buf = (unsigned char *) realloc(w->buf, w->capacity);
+        }
+        w->buf[w->n_bytes++] = (unsigned char)(w->acc & 0xff);
+        w->acc >>= 8;
+        w->n_bits -= 8;
+    }
+}
+
+static void
+_bw_put_wide(struct _bit_writer_t* w, uint64_t v, int n)    /* n <= 64 */
+{
+    if (n > 32) {
+        _bw_put(w, v, 32);
+        _bw_put(w, v >> 32, n - 32);
+    }
+    else
+        _bw_put(w, v, n);
+}
+
+static void
+_bw_flush(struct _bit_writer_t* w)
+{
+    if (w->n_bits > 0)
+        _bw_put(w, 0, 8 - w->n_bits);
+}
+
+static uint64_t
+_br_get(struct _bit_reader_t* r, int n)     /* n <= 32 */
+{
+    uint64_t v;
+    if (n == 0)
+        return 0;
+    while (r->n_bits < n) {
+        uint64_t b = (r->pos < r->n_bytes) ? r->buf[r->pos++] : 0;
+        r->acc |= b << r->n_bits;
+        r->n_bits += 8;
+    }
+    v = r->acc & ((UINT64_C(1) << n) - 1);
+    r->acc >>= n;
+    r->n_bits -= n;
+    return v;
+}
+
+static uint64_t
+_br_get_wide(struct _bit_reader_t* r, int n)    /* n <= 64 */
+{
+    if (n > 32) {
+        uint64_t lo = _br_get(r, 32);
+        return lo | (_br_get(r, n - 32) << 32);
+    }
+    return _br_get(r, n);
+}
+
+/*----------------------------------------------------------------------------
+ * Delta + Rice coding of one chunk of a column
+ *----------------------------------------------------------------------------*/
+
+/* Bit pattern of the value (rounded to float for width 32) */
+static uint64_t
+_bits(double v, int width)
+{
+    if (width == 32) {
+        float f = (float)v;
+        uint32_t u;
+        memcpy(&u, &f, 4);
+        return u;
+    }
+    uint64_t u;
+    memcpy(&u, &v, 8);
+    return u;
+}
+
+static double
+_from_bits(uint64_t u, int width)
+{
+    if (width == 32) {
+        uint32_t u32 = (uint32_t)u;
+        float f;
+        memcpy(&f, &u32, 4);
+        return f;
+    }
+    double d;
+    memcpy(&d, &u, 8);
+    return d;
+}
+
+/* Zigzag encoded difference of consecutive bit patterns */
+static uint64_t
+_delta_zz(uint64_t cur, uint64_t prev, int width)
+{
+    if (width == 32) {
+        uint32_t d = (uint32_t)cur - (uint32_t)prev;
+        return (uint32_t)((d << 1) ^ (uint32_t)((int32_t)d >> 31));
+    }
+    uint64_t d = cur - prev;
+    return (d << 1) ^ (uint64_t)((int64_t)d >> 63);
+}
+
+static uint64_t
+_undelta_zz(uint64_t z, uint64_t prev, int width)
+{
+    uint64_t d = (z >> 1) ^ (~(z & 1) + 1);
+    if (width == 32)
+        return (uint32_t)((uint32_t)prev + (uint32_t)d);
+    return prev + d;
+}
+
+static size_t
+_rice_cost(const uint64_t *z, size_t n, int k, int width)
+{
+    size_t cost = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t q = z[i] >> k;
+        cost += (q < RICE_ESCAPE) ? (size_t)(q + 1 + k) : (size_t)(RICE_ESCAPE + width);
+    }
+    return cost;
+}
+
+static int
+_encode_chunk(const double *v, size_t n, int width,
+              uint64_t *z, struct _bit_writer_t* w)
+{
+    uint64_t prev = 0;
+    double mean = 0.;
+    int k, k0, best_k;
+    size_t best_cost;
+
+    for (size_t i = 0; i < n; i++) {
+        uint64_t cur = _bits(v[i], width);
+        z[i] = _delta_zz(cur, prev, width);
+        prev = cur;
+        mean += (double)z[i];
+    }
+    mean /= (n > 0) ? n : 1;
+
+    /* Rice parameter: best one around log2(mean) */
+    k0 = (mean >= 1.) ? (int)log2(mean) : 0;
+    best_k = 0;
+    best_cost = (size_t)-1;
+    for (k = k0 - 2; k <= k0 + 2; k++) {
+        if (k < 0 || k >= width)
+            continue;
+        size_t cost = _rice_cost(z, n, k, width);
+        if (cost < best_cost) {
+            best_cost = cost;
+            best_k = k;
+        }
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        uint64_t q = z[i] >> best_k;
+        if (q < RICE_ESCAPE) {
+            _bw_put(w, (UINT64_C(1) << q) - 1, (int)q);     /* q ones */
+            _bw_put(w, 0, 1);
+            _bw_put_wide(w, z[i], best_k);
+        }
+        else {
+            _bw_put(w, 0xffffffff, RICE_ESCAPE);
+            _bw_put_wide(w, z[i], width);
+        }
+    }
+    _bw_flush(w);
+
+    return best_k;
+}
+
+/* Raw values of a chunk (width 32: rounded to float) */
+static size_t
+_raw_chunk(const double *v, size_t n, int width, unsigned char *buf)
+{
+    if (width == 32) {
+        for (size_t i = 0; i < n; i++) {
+            float f = (float)v[i];
+            memcpy(buf + i*sizeof(float), &f, sizeof(float));
+        }
+        return n*sizeof(float);
+    }
+    memcpy(buf, v, n*sizeof(double));
+    return n*sizeof(double);
+}
+
+static void
+_decode_chunk(struct _bit_reader_t* r, int k, int width, size_t n, double *v)
+{
+    uint64_t prev = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        uint64_t z, q = 0;
+        while (q < RICE_ESCAPE && _br_get(r, 1))
+            q++;
+        if (q < RICE_ESCAPE)
+            z = (q << k) | _br_get_wide(r, k);
+        else
+            z = _br_get_wide(r, width);
+        prev = _undelta_zz(z, prev, width);
+        v[i] = _from_bits(prev, width);
+    }
+}
+
+/*----------------------------------------------------------------------------
+ * Column table management
+ *----------------------------------------------------------------------------*/
+
+/* EXIT_FAILURE if out of memory, cols can then only be freed */
+static int
+_columns_alloc(struct profile_columns_t* cols, int n_cols, size_t n_rows)
+{
+    cols->n_cols = n_cols;
+    cols->n_rows = n_rows;
+    cols->names = calloc(n_cols, PROFILE_COL_NAME_LEN);
+    cols->encoding = (int *) malloc(n_cols*sizeof(int));
+    cols->col = (double **) calloc(n_cols, sizeof(double *));
+    if (cols->names == NULL || cols->encoding == NULL || cols->col == NULL)
+        return EXIT_FAILURE;
+    for (int j = 0; j < n_cols; j++) {
+        cols->encoding[j] = PROFILE_COL_DELTA_DOUBLE;
+        cols->col[j] = (double *) malloc((n_rows > 0 ? n_rows : 1)*sizeof(double));
+        if (cols->col[j] == NULL)
+            return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+static void
+_copy_name(char *dest, const char *src, size_t len)
+{
+    size_t i = 0;
+    /* skip blanks and quotes exported by some post-processing tools */
+    while (len > 0 && (*src == ' ' || *src == '"' || *src == '\t')) {
+        src++; len--;
+    }
+    while (len > 0 && (src[len-1] == ' ' || src[len-1] == '"'
+                       || src[len-1] == '\n' || src[len-1] == '\r'))
+        len--;
+    for (i = 0; i < len && i < PROFILE_COL_NAME_LEN - 1; i++)
+        dest[i] = src[i];
+    dest[i] = '\0';
+}
+
+
+int profile_columns_is_binary(const char *fName)
+{
+    char magic[8];
+    FILE* stream = fopen(fName, "rb");
+    int is_binary = 0;
+    if (stream == NULL)
+        return 0;
+    if (fread(magic, 1, 8, stream) == 8)
+        is_binary = (memcmp(magic, _magic, 8) == 0);
+    fclose(stream);
+    return is_binary;
+}
+
+
+/*----------------------------------------------------------------------------
+ * CSV parsing, by newline-aligned chunks of the file (one OpenMP task each)
+ *----------------------------------------------------------------------------*/
+
+#define CSV_MIN_CHUNK 65536         /* bytes */
+#define CSV_LOAD_BLOCK (1 << 20)    /* first read size when only max_rows rows are needed */
+
+struct _csv_chunk_t {
+    const char *start, *end;
+    size_t first_row, n_rows;
+};
+
+/* Empty lines (or "\r" only) are skipped */
+static int
+_csv_is_blank(const char *s, const char *e)
+{
+    for (; s < e; s++)
+        if (*s != '\r' && *s != ' ' && *s != '\t')
+            return 0;
+    return 1;
+}
+
+static size_t
+_csv_count_rows(const char *s, const char *end)
+{
+    size_t n = 0;
+    while (s < end) {
+        const char *e = memchr(s, '\n', end - s);
+        if (e == NULL)
+            e = end;
+        if (!_csv_is_blank(s, e))
+            n++;
+        s = e + 1;
+    }
+    return n;
+}
+
+/* Reentrant: only strtod() and memchr() on the [s, end) range */
+static void
+_csv_parse_rows(const char *s, const char *end, size_t i, size_t n_rows,
+                struct profile_columns_t* cols)
+{
+    const int n_cols = cols->n_cols;
+
+    while (s < end && i < n_rows) {
+        const char *e = memchr(s, '\n', end - s);
+        if (e == NULL)
+            e = end;
+        if (_csv_is_blank(s, e)) {
+            s = e + 1;
+            continue;
+        }
+        const char *c = s;
+        for (int j = 0; j < n_cols; j++) {
+            /* strtod() skips newlines: a value found past the end of the
+               line (empty last field, trailing comma) belongs to the next row */
+            char *v_end = (char *)e;
+            double v = (c < e) ? strtod(c, &v_end) : 0.;
+            if (v_end > e) {
+                v = 0.;
+                v_end = (char *)e;
+            }
+            cols->col[j][i] = v;
+            c = (v_end < e) ? memchr(v_end, ',', e - v_end) : NULL;
+            if (c == NULL) {
+                for (j = j + 1; j < n_cols; j++)
+                    cols->col[j][i] = 0.;
+                break;
+            }
+            c++;
+        }
+        i++;
+        s = e + 1;
+    }
+}
+
+
+/* File contents terminated for strtod(): the whole file, or only the
+   first blocks holding the header and max_rows rows if max_rows > 0 */
+static char *
+_csv_load(FILE *stream, size_t max_rows, size_t *size)
+{
+    char *buf = NULL;
+    size_t n = 0, capacity = 0, block = CSV_LOAD_BLOCK;
+
+    if (max_rows == 0 && fseek(stream, 0, SEEK_END) == 0) {
+        long l = ftell(stream);
+        if (l > 0 && fseek(stream, 0, SEEK_SET) == 0)
+            block = (size_t)l + 1;
+    }
+
+    for (;;) {
+        capacity = n + block + 1;
+        buf = (char *) realloc(buf, capacity);
+        size_t r = fread(buf + n, 1, block, stream);
+        n += r;
+        if (r < block)
+            break;
+        if (max_rows > 0) {     //enough complete rows after the header?
+            const char *body = memchr(buf, '\n', n);
+            const char *last = buf + n;
+            while (body != NULL && last > body && last[-1] != '\n')
+                last--;
+            if (body != NULL && _csv_count_rows(body + 1, last) >= max_rows)
+                break;
+        }
+        block *= 2;
+    }
+
+    if (n == 0) {
+        free(buf);
+        return NULL;
+    }
+    buf[n] = '\0';
+    *size = n;
+    return buf;
+}
+
+
+int profile_columns_read_csv(const char *fName, struct profile_columns_t* cols)
+{
+    return profile_columns_read_csv_rows(fName, 0, cols);
+}
+
+
+/* Columns named by the header [head, head_end) and rows of [body, end),
+   parsed by newline-aligned chunks at their row offset */
+static int
+_csv_columns(const char *head, const char *head_end,
+             const char *body, const char *end,
+             size_t max_rows, struct profile_columns_t* cols)
+{
+    int n_cols = 1;
+    for (const char *c = head; c < head_end; c++)
+        if (*c == ',') n_cols++;
+
+    /* Newline-aligned chunks */
+    int n_chunks = 1;
+#if defined(_OPENMP)
+    n_chunks = 4*omp_get_max_threads();
+#endif
+    if ((size_t)(end - body)/CSV_MIN_CHUNK + 1 < (size_t)n_chunks)
+        n_chunks = (int)((size_t)(end - body)/CSV_MIN_CHUNK + 1);
+
+    struct _csv_chunk_t *chunk = (struct _csv_chunk_t *) malloc(n_chunks*sizeof(struct _csv_chunk_t));
+    {
+        const char *s = body;
+        for (int c = 0; c < n_chunks; c++) {
+            const char *e = body + (size_t)(end - body)*(c + 1)/n_chunks;
+            if (e < s)
+                e = s;
+            if (c == n_chunks - 1)
+                e = end;
+            else {
+                const char *nl = memchr(e, '\n', end - e);
+                e = (nl != NULL) ? nl + 1 : end;
+            }
+            chunk[c].start = s;
+            chunk[c].end = e;
+            s = e;
+        }
+    }
+
+    /* Row offsets of the chunks (counting pass, then prefix sum) */
+    #pragma omp parallel for schedule(dynamic)
+    for (int c = 0; c < n_chunks; c++)
+        chunk[c].n_rows = _csv_count_rows(chunk[c].start, chunk[c].end);
+
+    size_t n_rows = 0;
+    for (int c = 0; c < n_chunks; c++) {
+        chunk[c].first_row = n_rows;
+        n_rows += chunk[c].n_rows;
+    }
+    if (max_rows > 0 && n_rows > max_rows)
+        n_rows = max_rows;
+
+    if (_columns_alloc(cols, n_cols, n_rows) != EXIT_SUCCESS) {
+        free(chunk);
+        profile_columns_free(cols);
+        return EXIT_FAILURE;
+    }
+    {
+        const char *s = head;
+        for (int j = 0; j < n_cols; j++) {
+            const char *e = memchr(s, ',', head_end - s);
+            size_t len = (e != NULL) ? (size_t)(e - s) : (size_t)(head_end - s);
+            _copy_name(cols->names[j], s, len);
+            s = (e != NULL) ? e + 1 : head_end;
+        }
+    }
+
+    /* Parse the chunks in parallel, each one at its row offset */
+    #pragma omp parallel for schedule(dynamic)
+    for (int c = 0; c < n_chunks; c++)
+        if (chunk[c].first_row < n_rows)
+            _csv_parse_rows(chunk[c].start, chunk[c].end, chunk[c].first_row,
+                            n_rows, cols);
+
+    free(chunk);
+    return EXIT_SUCCESS;
+}
+
+
+int profile_columns_read_csv_rows(const char *fName,
+                                  size_t max_rows,
+                                  struct profile_columns_t* cols)
+{
+    FILE* stream = fopen(fName, "rb");
+    if (stream == NULL)
+        return EXIT_FAILURE;
+
+    memset(cols, 0, sizeof(struct profile_columns_t));
+
+    size_t size;
+    char *buf = _csv_load(stream, max_rows, &size);
+    fclose(stream);
+    if (buf == NULL)
+        return EXIT_FAILURE;
+
+    const char *end = buf + size;
+    const char *body = memchr(buf, '\n', size);     //header
+    body = (body != NULL) ? body + 1 : end;
+
+    int ret = _csv_columns(buf, body, body, end, max_rows, cols);
+
+    free(buf);
+    return ret;
+}
+
+
+int profile_columns_read_csv_part(const char *fName,
+                                  int part,
+                                  int n_parts,
+                                  struct profile_columns_t* cols)
+{
+    char *head = NULL, *buf = NULL;
+    size_t n_head = 0, n = 0;
+
+    memset(cols, 0, sizeof(struct profile_columns_t));
+    if (n_parts < 1 || part < 0 || part >= n_parts)
+        return EXIT_FAILURE;
+
+    FILE* stream = fopen(fName, "rb");
+    if (stream == NULL)
+        return EXIT_FAILURE;
+
+    /* Header line */
+    for (;;) {
+        head = (char *) realloc(head, n_head + CSV_MIN_CHUNK + 1);
+        size_t r = fread(head + n_head, 1, CSV_MIN_CHUNK, stream);
+        const char *nl = memchr(head + n_head, '\n', r);
+        n_head += r;
+        if (nl != NULL) {
+            n_head = (size_t)(nl - head) + 1;
+            break;
+        }
+        if (r < CSV_MIN_CHUNK)
+            break;
+    }
+    if (n_head == 0 || fseek(stream, 0, SEEK_END) != 0) {
+        free(head);
+        fclose(stream);
+        return EXIT_FAILURE;
+    }
+
+    /* Byte range of the part: the rows starting in [lo, hi), read from
+       lo - 1 to see whether a row starts at lo, up to the end of the row
+       holding byte hi - 1 */
+    const long size = ftell(stream);
+    const long data = (long)n_head;
+    const long lo = data + (long)((double)(size - data)*part/n_parts);
+    const long hi = (part == n_parts - 1) ? size
+                  : data + (long)((double)(size - data)*(part + 1)/n_parts);
+    const long from = (lo > data) ? lo - 1 : data;
+    int ret = EXIT_SUCCESS;
+
+    if (hi > lo && fseek(stream, from, SEEK_SET) == 0) {
+        size_t capacity = (size_t)(hi - from) + CSV_MIN_CHUNK;
+        buf = (char *) malloc(capacity + 1);
+        n = fread(buf, 1, (size_t)(hi - from), stream);
+        while (n >= (size_t)(hi - from)) {
+            const size_t last = (size_t)(hi - 1 - from);
+            if (memchr(buf + last, '\n', n - last) != NULL)
+                break;
+            if (n + CSV_MIN_CHUNK > capacity) {
+                capacity *= 2;
+                buf = (char *) realloc(buf, capacity + 1);
+            }
+            size_t r = fread(buf + n, 1, CSV_MIN_CHUNK, stream);
+            n += r;
+            if (r < CSV_MIN_CHUNK)
+                break;
+        }
+        if (n < (size_t)(hi - from))
+            ret = EXIT_FAILURE;
+    }
+    else if (hi > lo)
+        ret = EXIT_FAILURE;
+    fclose(stream);
+
+    if (ret == EXIT_SUCCESS) {
+        const char *body = (buf != NULL) ? buf : head + n_head;
+        const char *end = body;
+        if (buf != NULL) {
+            buf[n] = '\0';
+            if (from < lo) {                /* first row starting at or after lo */
+                const char *nl = memchr(buf, '\n', n);
+                body = (nl != NULL) ? nl + 1 : buf + n;
+            }
+            const char *nl = memchr(buf + (hi - 1 - from), '\n', n - (size_t)(hi - 1 - from));
+            end = (nl != NULL) ? nl + 1 : buf + n;
+            if (end < body)
+                end = body;
+        }
+        ret = _csv_columns(head, head + n_head, body, end, 0, cols);
+    }
+
+    free(buf);
+    free(head);
+    return ret;
+}
+
+
+int profile_columns_read(const char *fName, struct profile_columns_t* cols)
+{
+    FILE* stream = fopen(fName, "rb");
+    if (stream == NULL)
+        return EXIT_FAILURE;
+
+    char magic[8];
+    uint64_t n_rows;
+    uint32_t hdr[2];
+    int status = EXIT_SUCCESS;
+
+    memset(cols, 0, sizeof(struct profile_columns_t));
+    if (   fread(magic, 1, 8, stream) != 8
+        || memcmp(magic, _magic, 8) != 0
+        || fread(&n_rows, sizeof(uint64_t), 1, stream) != 1
+        || fread(hdr, sizeof(uint32_t), 2, stream) != 2
+        || hdr[1] == 0) {
+        fclose(stream);
+        return EXIT_FAILURE;
+    }
+
+    const int n_cols = (int)hdr[0];
+    const size_t chunk_rows = hdr[1];
+
+    /* File size, to reject chunk lengths past the end */
+    const long data_start = ftell(stream);
+    fseek(stream, 0, SEEK_END);
+    const long file_size = ftell(stream);
+    fseek(stream, data_start, SEEK_SET);
+
+    /* Sizes the file can hold: a 24 byte description per column, then
+       for each chunk of each column 8 bytes and at least a bit per value */
+    const uint64_t col_desc = PROFILE_COL_NAME_LEN + 2*sizeof(uint32_t);
+    const uint64_t avail = (file_size > data_start) ? (uint64_t)(file_size - data_start) : 0;
+    if (   hdr[0] == 0 || hdr[0] > PROFILE_COL_MAX_COLS
+        || hdr[0]*col_desc > avail
+        || n_rows > 8*(avail - hdr[0]*col_desc)/hdr[0]
+        || (n_rows + chunk_rows - 1)/chunk_rows*hdr[0]*8 > avail - hdr[0]*col_desc) {
+        fclose(stream);
+        return EXIT_FAILURE;
+    }
+
+    if (_columns_alloc(cols, n_cols, (size_t)n_rows) != EXIT_SUCCESS) {
+        profile_columns_free(cols);
+        fclose(stream);
+        return EXIT_FAILURE;
+    }
+
+    for (int j = 0; j < n_cols; j++) {
+        uint32_t enc[2];
+        if (   fread(cols->names[j], 1, PROFILE_COL_NAME_LEN, stream) != PROFILE_COL_NAME_LEN
+            || fread(enc, sizeof(uint32_t), 2, stream) != 2) {
+            status = EXIT_FAILURE;
+            break;
+        }
+        cols->names[j][PROFILE_COL_NAME_LEN-1] = '\0';
+        cols->encoding[j] = (int)enc[0];
+    }
+
+    /* Decode chunk by chunk into the double precision columns */
+    unsigned char *buf = NULL;
+    size_t buf_size = 0;
+
+    for (size_t start = 0; start < n_rows && status == EXIT_SUCCESS; start += chunk_rows) {
+        size_t n = ((size_t)n_rows - start < chunk_rows) ? (size_t)n_rows - start : chunk_rows;
+
+        for (int j = 0; j < n_cols; j++) {
+            uint32_t ch[2];
+            double *v = cols->col[j] + start;
+            if (fread(ch, sizeof(uint32_t), 2, stream) != 2) {
+                status = EXIT_FAILURE;
+                break;
+            }
+
+            /* Stored length: within the file, and enough for n raw values */
+            size_t raw_size = 0;
+            if (cols->encoding[j] == PROFILE_COL_DOUBLE)
+                raw_size = n*sizeof(double);
+            else if (cols->encoding[j] == PROFILE_COL_FLOAT)
+                raw_size = n*sizeof(float);
+            else if (ch[0] == PROFILE_COL_RAW_CHUNK)
+                raw_size = (cols->encoding[j] == PROFILE_COL_DELTA_FLOAT) ? n*sizeof(float)
+                                                                          : n*sizeof(double);
+            if (   ch[1] < raw_size
+                || (long)ch[1] > file_size - ftell(stream)) {
+                status = EXIT_FAILURE;
+                break;
+            }
+
+            if (ch[1] > buf_size) {
+                buf_size = ch[1];
+                buf = (unsigned char *) realloc(buf, buf_size);
+            }
+            if (fread(buf, 1, ch[1], stream) != ch[1]) {
+                status = EXIT_FAILURE;
+                break;
+            }
+
+            switch (cols->encoding[j]) {
+            case PROFILE_COL_DOUBLE:
+                memcpy(v, buf, n*sizeof(double));
+                break;
+            case PROFILE_COL_FLOAT:
+                {
+                    const float *f = (const float *)buf;
+                    for (size_t i = 0; i < n; i++)
+                        v[i] = f[i];
+                }
+                break;
+            case PROFILE_COL_DELTA_DOUBLE:
+            case PROFILE_COL_DELTA_FLOAT:
+                {
+                    struct _bit_reader_t r = {buf, 0, ch[1], 0, 0};
+                    int width = (cols->encoding[j] == PROFILE_COL_DELTA_FLOAT) ? 32 : 64;
+                    if (ch[0] == PROFILE_COL_RAW_CHUNK && width == 32) {
+                        const float *f = (const float *)buf;
+                        for (size_t i = 0; i < n; i++)
+                            v[i] = f[i];
+                    }
+                    else if (ch[0] == PROFILE_COL_RAW_CHUNK)
+                        memcpy(v, buf, n*sizeof(double));
+                    else if (ch[0] < (uint32_t)width)
+                        _decode_chunk(&r, (int)ch[0], width, n, v);
+                    else
+                        status = EXIT_FAILURE;
+                }
+                break;
+            default:
+                status = EXIT_FAILURE;
+            }
+        }
+    }
+
+    free(buf);
+    fclose(stream);
+    if (status != EXIT_SUCCESS)
+        profile_columns_free(cols);
+    return status;
+}
+
+
+int profile_columns_write(const char *fName, const struct profile_columns_t* cols)
+{
+    FILE* stream = fopen(fName, "wb");
+    if (stream == NULL)
+        return EXIT_FAILURE;
+
+    uint64_t n_rows = cols->n_rows;
+    uint32_t hdr[2] = {(uint32_t)cols->n_cols, PROFILE_COL_CHUNK};
+
+    fwrite(_magic, 1, 8, stream);
+    fwrite(&n_rows, sizeof(uint64_t), 1, stream);
+    fwrite(hdr, sizeof(uint32_t), 2, stream);
+    for (int j = 0; j < cols->n_cols; j++) {
+        uint32_t enc[2] = {(uint32_t)cols->encoding[j], 0};
+        fwrite(cols->names[j], 1, PROFILE_COL_NAME_LEN, stream);
+        fwrite(enc, sizeof(uint32_t), 2, stream);
+    }
+
+    uint64_t *z = (uint64_t *) malloc(PROFILE_COL_CHUNK*sizeof(uint64_t));
+    float *f = (float *) malloc(PROFILE_COL_CHUNK*sizeof(float));
+    unsigned char *raw = (unsigned char *) malloc(PROFILE_COL_CHUNK*sizeof(double));
+    struct _bit_writer_t w = {NULL, 0, 0, 0, 0};
+
+    for (size_t start = 0; start < cols->n_rows; start += PROFILE_COL_CHUNK) {
+        size_t n = (cols->n_rows - start < PROFILE_COL_CHUNK) ? cols->n_rows - start
+                                                              : PROFILE_COL_CHUNK;
+        for (int j = 0; j < cols->n_cols; j++) {
+            const double *v = cols->col[j] + start;
+            uint32_t ch[2] = {0, 0};
+            const void *payload = v;
+
+            switch (cols->encoding[j]) {
+            case PROFILE_COL_FLOAT:
+                for (size_t i = 0; i < n; i++)
+                    f[i] = (float)v[i];
+                payload = f;
+                ch[1] = (uint32_t)(n*sizeof(float));
+                break;
+            case PROFILE_COL_DELTA_DOUBLE:
+            case PROFILE_COL_DELTA_FLOAT:
+                {
+                    const int width = (cols->encoding[j] == PROFILE_COL_DELTA_FLOAT) ? 32 : 64;
+                    w.n_bytes = 0;
+                    ch[0] = (uint32_t)_encode_chunk(v, n, width, z, &w);
+                    payload = w.buf;
+                    ch[1] = (uint32_t)w.n_bytes;
+                    /* Noisy chunk: the coding does not pay, store it raw */
+                    if (w.n_bytes >= n*width/8) {
+                        ch[0] = PROFILE_COL_RAW_CHUNK;
+                        ch[1] = (uint32_t)_raw_chunk(v, n, width, raw);
+                        payload = raw;
+                    }
+                }
+                break;
+            default:
+                ch[1] = (uint32_t)(n*sizeof(double));
+            }
+            fwrite(ch, sizeof(uint32_t), 2, stream);
+            fwrite(payload, 1, ch[1], stream);
+        }
+    }
+
+    free(w.buf);
+    free(raw);
+    free(f);
+    free(z);
+    return (fclose(stream) == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+int profile_columns_set_encoding(struct profile_columns_t* cols,
+                                 const char *name,
+                                 enum profile_col_encoding_t encoding)
+{
+    int j = profile_columns_find(cols, name);
+    if (j < 0)
+        return EXIT_FAILURE;
+    cols->encoding[j] = encoding;
+    return EXIT_SUCCESS;
+}
+
+
+int profile_columns_find(const struct profile_columns_t* cols, const char *name)
+{
+    for (int j = 0; j < cols->n_cols; j++)
+        if (strcmp(cols->names[j], name) == 0)
+            return j;
+    return -1;
+}
+
+
+void profile_columns_free(struct profile_columns_t* cols)
+{
+    if (cols->col != NULL)
+        for (int j = 0; j < cols->n_cols; j++)
+            free(cols->col[j]);
+    free(cols->col);
+    free(cols->encoding);
+    free(cols->names);
+    memset(cols, 0, sizeof(struct profile_columns_t));
+}
+
+
+/* Column ids by name, or by position in the CSV layout if any name is missing */
+static int
+_map_columns(const struct profile_columns_t* cols, int n,
+             const char **names, const int *pos, int *ids)
+{
+    int found = 1;
+    for (int i = 0; i < n; i++) {
+        ids[i] = profile_columns_find(cols, names[i]);
+        if (ids[i] < 0)
+            found = 0;
+    }
+    if (!found) {
+        for (int i = 0; i < n; i++) {
+            if (pos[i] >= cols->n_cols)
+                return EXIT_FAILURE;
+            ids[i] = pos[i];
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+
+int profile_columns_to_keps(const struct profile_columns_t* cols,
+                            size_t num_lines,
+                            struct profile_keps_t* rows)
+{
+    int id[5];
+    size_t n = (cols->n_rows < num_lines) ? cols->n_rows : num_lines;
+
+    if (_map_columns(cols, 5, _keps_names, _keps_pos, id) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+
+    for (size_t i = 0; i < n; i++) {
+        rows->rec[i].y   = cols->col[id[0]][i];
+        rows->rec[i].u   = cols->col[id[1]][i];
+        rows->rec[i].v   = cols->col[id[2]][i];
+        rows->rec[i].k   = cols->col[id[3]][i];
+        rows->rec[i].eps = cols->col[id[4]][i];
+    }
+    rows->n_rows = n;
+    return EXIT_SUCCESS;
+}
+
+
+int profile_columns_to_rijssg(const struct profile_columns_t* cols,
+                              size_t num_lines,
+                              struct profile_rijssg_t* rows)
+{
+    int id[10];
+    size_t n = (cols->n_rows < num_lines) ? cols->n_rows : num_lines;
+
+    if (_map_columns(cols, 10, _rij_names, _rij_pos, id) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+
+    for (size_t i = 0; i < n; i++) {
+        rows->rec[i].y   = cols->col[id[0]][i];
+        rows->rec[i].u   = cols->col[id[1]][i];
+        rows->rec[i].v   = cols->col[id[2]][i];
+        rows->rec[i].rxx = cols->col[id[3]][i];
+        rows->rec[i].ryy = cols->col[id[4]][i];
+        rows->rec[i].rzz = cols->col[id[5]][i];
+        rows->rec[i].rxy = cols->col[id[6]][i];
+        rows->rec[i].ryz = cols->col[id[7]][i];
+        rows->rec[i].rxz = cols->col[id[8]][i];
+        rows->rec[i].eps = cols->col[id[9]][i];
+    }
+    rows->n_rows = n;
+    return EXIT_SUCCESS;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,118 @@
+#ifndef PROFILE_COLUMNS_H
+#define PROFILE_COLUMNS_H
+
+#include <stddef.h>
+
+#include "read_from_ke_profile.h"
+#include "read_from_rije_profile.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PROFILE_COL_NAME_LEN 16
+#define PROFILE_COL_CHUNK 4096      /* rows per compressed chunk */
+
+
+/* Storage of one column in a binary profile file */
+enum profile_col_encoding_t {
+    PROFILE_COL_DOUBLE = 0,         /* raw float64 */
+    PROFILE_COL_FLOAT = 1,          /* raw float32 (rounded) */
+    PROFILE_COL_DELTA_DOUBLE = 2,   /* lossless: float64 delta + Rice coding, per chunk
+                                       raw where the coding does not pay */
+    PROFILE_COL_DELTA_FLOAT = 3     /* float32 rounding, then delta + Rice coding */
+};
+
+
+/**
+* Column-wise profile or inflow table.
+* Values are always decoded to double precision, col[j][i] is row i of column j.
+*/
+struct profile_columns_t {
+    size_t n_rows;
+    int n_cols;
+    char (*names)[PROFILE_COL_NAME_LEN];
+    int *encoding;                  /* enum profile_col_encoding_t, per column */
+    double **col;
+};
+
+
+/**
+* Returns 1 if fName is a binary column file (checks the magic string).
+*/
+int profile_columns_is_binary(const char *fName);
+
+/**
+* Read a CSV file with a header line into columns (all stored as
+* PROFILE_COL_DELTA_DOUBLE by default).
+* The file is split into newline-aligned chunks parsed in parallel
+* (OpenMP) at their row offset, so row order is kept.
+*/
+int profile_columns_read_csv(const char *fName, struct profile_columns_t* cols);
+
+/**
+* Same as profile_columns_read_csv(), keeping at most max_rows rows
+* (all rows if max_rows is 0).
+*/
+int profile_columns_read_csv_rows(const char *fName,
+                                  size_t max_rows,
+                                  struct profile_columns_t* cols);
+
+/**
+* Read the header and one part of the rows of a CSV file: the data are
+* split into n_parts byte ranges and a row belongs to the range holding
+* its first character, so the parts hold every row exactly once. Only
+* that range is read (up to the end of its last row), and it is parsed
+* as by profile_columns_read_csv(). Lets each MPI rank read a share of
+* a large file.
+*/
+int profile_columns_read_csv_part(const char *fName,
+                                  int part,
+                                  int n_parts,
+                                  struct profile_columns_t* cols);
+
+/**
+* Read a binary column file, decoding chunk by chunk into the
+* double precision columns.
+*/
+int profile_columns_read(const char *fName, struct profile_columns_t* cols);
+
+/**
+* Write a binary column file using cols->encoding for each column.
+* Float columns keep a relative error below 2^-24 (6.0e-8),
+* the other encodings are exact.
+*/
+int profile_columns_write(const char *fName, const struct profile_columns_t* cols);
+
+/**
+* Set the encoding of a column by name. Returns EXIT_FAILURE if not found.
+*/
+int profile_columns_set_encoding(struct profile_columns_t* cols,
+                                 const char *name,
+                                 enum profile_col_encoding_t encoding);
+
+/**
+* Index of a column by name, -1 if not found.
+*/
+int profile_columns_find(const struct profile_columns_t* cols, const char *name);
+
+void profile_columns_free(struct profile_columns_t* cols);
+
+/**
+* Copy the y,u,v,k,eps (resp. y,u,v,rxx..rxz,eps) columns into at most
+* num_lines records; rows->n_rows is set to the number of copied rows.
+*/
+int profile_columns_to_keps(const struct profile_columns_t* cols,
+                            size_t num_lines,
+                            struct profile_keps_t* rows);
+
+int profile_columns_to_rijssg(const struct profile_columns_t* cols,
+                              size_t num_lines,
+                              struct profile_rijssg_t* rows);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PROFILE_COLUMNS_H
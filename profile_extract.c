@@ -0,0 +1,273 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "cs_defs.h"
+
+#include "bft_mem.h"
+#include "bft_error.h"
+#include "bft_printf.h"
+
+#include "cs_field.h"
+#include "cs_field_pointer.h"
+#include "cs_mesh.h"
+#include "cs_mesh_quantities.h"
+#include "cs_selector.h"
+#include "cs_time_step.h"
+#include "cs_turbulence_model.h"
+
+#include "profile_columns.h"
+#include "profile_extract.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PROFILE_EXTRACT_GEOM 4      /* volume, x, y, z */
+
+/* Column names, in the order of the CSV layout read by read_profile_keps()
+   and read_profile_SSG() */
+static const char *_keps_cols[] = {"s", "x", "y", "z", "u", "v", "k", "eps"};
+static const char *_rij_cols[] = {"s", "x", "y", "z", "u", "v",
+                                  "rxx", "ryy", "rzz", "rxy", "ryz", "rxz", "eps"};
+
+
+int profile_extract_setup(const char *criteria,
+                          cs_real_t y_min,
+                          cs_real_t y_max,
+                          int n_bins,
+                          struct profile_extract_t* pe)
+{
+    const cs_mesh_t *m = cs_glob_mesh;
+    const cs_real_3_t *cell_cen = (const cs_real_3_t *) cs_glob_mesh_quantities->cell_cen;
+    cs_lnum_t n_sel = 0;
+    cs_lnum_t *sel = NULL;
+
+    memset(pe, 0, sizeof(struct profile_extract_t));
+    if (n_bins < 1) {
+        bft_printf("Profile extraction: %d bins.\n", n_bins);
+        return EXIT_FAILURE;
+    }
+    if (cs_glob_turb_model->itytur != 2 && cs_glob_turb_model->itytur != 3) {
+        bft_printf("Profile extraction: k-epsilon or Rij-epsilon model required.\n");
+        return EXIT_FAILURE;
+    }
+
+    BFT_MALLOC(sel, m->n_cells, cs_lnum_t);
+    cs_selector_get_cell_list(criteria, &n_sel, sel);
+
+    /* Default range: extent of the selected cells */
+    if (y_min >= y_max) {
+        cs_real_t ext[2] = {HUGE_VAL, HUGE_VAL};      /* -y_max, y_min */
+        for (cs_lnum_t i = 0; i < n_sel; i++) {
+            const cs_real_t y = cell_cen[sel[i]][1];
+            if (y < ext[1]) ext[1] = y;
+            if (-y < ext[0]) ext[0] = -y;
+        }
+#if defined(HAVE_MPI)
+        if (cs_glob_n_ranks > 1)
+            MPI_Allreduce(MPI_IN_PLACE, ext, 2, CS_MPI_REAL, MPI_MIN, cs_glob_mpi_comm);
+#endif
+        y_min = ext[1];
+        y_max = -ext[0];
+        if (!(y_min <= y_max)) {
+            bft_printf("Profile extraction: no cell selected by \"%s\".\n", criteria);
+            BFT_FREE(sel);
+            return EXIT_FAILURE;
+        }
+        /* Cells at y_max fall in the last bin */
+        y_max += 1.e-9*(fabs(y_max - y_min) + fabs(y_max));
+    }
+
+    pe->n_bins = n_bins;
+    pe->y_min = y_min;
+    pe->dy = (y_max - y_min)/n_bins;
+    pe->rij = (cs_glob_turb_model->itytur == 3);
+    pe->n_vals = PROFILE_EXTRACT_GEOM + 2 + (pe->rij ? 7 : 2);
+
+    /* Cell -> bin map, built once */
+    pe->n_cells = m->n_cells;
+    BFT_MALLOC(pe->cell_bin, m->n_cells, int);
+    for (cs_lnum_t i = 0; i < m->n_cells; i++)
+        pe->cell_bin[i] = -1;
+    for (cs_lnum_t i = 0; i < n_sel; i++) {
+        const cs_real_t b = floor((cell_cen[sel[i]][1] - y_min)/pe->dy);
+        if (b >= 0. && b < n_bins)
+            pe->cell_bin[sel[i]] = (int)b;
+    }
+    BFT_FREE(sel);
+
+    BFT_MALLOC(pe->sums, n_bins*pe->n_vals, cs_real_t);
+    BFT_MALLOC(pe->mean, n_bins*pe->n_vals, cs_real_t);
+    memset(pe->mean, 0, n_bins*pe->n_vals*sizeof(cs_real_t));
+
+    bft_printf("Profile extraction: %d bins of %g between y = %g and %g.\n",
+               n_bins, pe->dy, y_min, y_min + n_bins*pe->dy);
+    return EXIT_SUCCESS;
+}
+
+
+void profile_extract_sample(struct profile_extract_t* pe, int interval)
+{
+    const cs_real_3_t *cell_cen = (const cs_real_3_t *) cs_glob_mesh_quantities->cell_cen;
+    const cs_real_t *cell_vol = cs_glob_mesh_quantities->cell_vol;
+    const int n_turb = pe->rij ? 6 : 1;
+    const int n_vals = pe->n_vals;
+
+    if (   pe->cell_bin == NULL || interval <= 0
+        || cs_glob_time_step->nt_cur % interval != 0)
+        return;
+
+    const cs_real_3_t *vel = (const cs_real_3_t *) CS_F_(u)->val;
+    const cs_real_t *eps = CS_F_(eps)->val;
+    const cs_real_t *turb = pe->rij ? CS_F_(rij)->val : CS_F_(k)->val;
+    if (pe->n_cells != cs_glob_mesh->n_cells)
+        bft_error(__FILE__, __LINE__, 0,
+                  "Profile extraction: the mesh changed since the setup.\n");
+
+    /* Volume weighted sums over the local cells of each bin */
+    memset(pe->sums, 0, pe->n_bins*n_vals*sizeof(cs_real_t));
+    for (cs_lnum_t i = 0; i < pe->n_cells; i++) {
+        const int b = pe->cell_bin[i];
+        if (b < 0)
+            continue;
+        const cs_real_t w = cell_vol[i];
+        cs_real_t *s = pe->sums + b*n_vals;
+        s[0] += w;
+        s[1] += w*cell_cen[i][0];
+        s[2] += w*cell_cen[i][1];
+        s[3] += w*cell_cen[i][2];
+        s[4] += w*vel[i][0];
+        s[5] += w*vel[i][1];
+        for (int j = 0; j < n_turb; j++)
+            s[6 + j] += w*turb[i*n_turb + j];
+        s[6 + n_turb] += w*eps[i];
+    }
+
+    /* One reduction to rank 0 */
+#if defined(HAVE_MPI)
+    if (cs_glob_n_ranks > 1) {
+        if (cs_glob_rank_id == 0)
+            MPI_Reduce(MPI_IN_PLACE, pe->sums, pe->n_bins*n_vals, CS_MPI_REAL, MPI_SUM, 0,
+                       cs_glob_mpi_comm);
+        else
+            MPI_Reduce(pe->sums, NULL, pe->n_bins*n_vals, CS_MPI_REAL, MPI_SUM, 0,
+                       cs_glob_mpi_comm);
+    }
+#endif
+
+    if (cs_glob_rank_id > 0)
+        return;
+
+    /* Running time average of the bin means (the volume is kept as is) */
+    pe->n_samples++;
+    const cs_real_t a = 1./pe->n_samples;
+    for (int b = 0; b < pe->n_bins; b++) {
+        const cs_real_t *s = pe->sums + b*n_vals;
+        cs_real_t *mean = pe->mean + b*n_vals;
+        mean[0] = s[0];
+        if (s[0] <= 0.)
+            continue;
+        for (int j = 1; j < n_vals; j++)
+            mean[j] += a*(s[j]/s[0] - mean[j]);
+    }
+}
+
+
+void profile_extract_reset(struct profile_extract_t* pe)
+{
+    pe->n_samples = 0;
+    if (pe->mean != NULL)
+        memset(pe->mean, 0, pe->n_bins*pe->n_vals*sizeof(cs_real_t));
+}
+
+
+int profile_extract_write(const struct profile_extract_t* pe,
+                          const char *fName,
+                          enum profile_extract_format_t format)
+{
+    const int n_cols = pe->n_vals;              /* s replaces the volume */
+    const char **names = pe->rij ? _rij_cols : _keps_cols;
+    int ret = EXIT_SUCCESS;
+
+    if (cs_glob_rank_id > 0 || pe->mean == NULL)
+        return EXIT_SUCCESS;
+    if (pe->n_samples == 0) {
+        bft_printf("Profile extraction: no sample, %s not written.\n", fName);
+        return EXIT_FAILURE;
+    }
+
+    /* Non-empty bins only, bottom up */
+    size_t n_rows = 0;
+    for (int b = 0; b < pe->n_bins; b++)
+        if (pe->mean[b*pe->n_vals] > 0.)
+            n_rows++;
+
+    if (format == PROFILE_EXTRACT_CSV) {
+        FILE* stream = fopen(fName, "w");
+        if (stream == NULL) {
+            bft_printf("Profile extraction: cannot open %s.\n", fName);
+            return EXIT_FAILURE;
+        }
+        for (int j = 0; j < n_cols; j++)
+            fprintf(stream, (j == 0) ? "%s" : ",%s", names[j]);
+        fprintf(stream, "\n");
+        size_t s = 0;
+        for (int b = 0; b < pe->n_bins; b++) {
+            const cs_real_t *mean = pe->mean + b*pe->n_vals;
+            if (mean[0] <= 0.)
+                continue;
+            fprintf(stream, "%lu", (unsigned long)(s++));
+            for (int j = 1; j < pe->n_vals; j++)
+                fprintf(stream, ",%.10g", mean[j]);
+            fprintf(stream, "\n");
+        }
+        if (fclose(stream) != 0)
+            ret = EXIT_FAILURE;
+    }
+    else {
+        struct profile_columns_t cols;
+        cols.n_rows = n_rows;
+        cols.n_cols = n_cols;
+        cols.names = calloc(n_cols, PROFILE_COL_NAME_LEN);
+        cols.encoding = (int *) malloc(n_cols*sizeof(int));
+        cols.col = (double **) malloc(n_cols*sizeof(double *));
+        for (int j = 0; j < n_cols; j++) {
+            strncpy(cols.names[j], names[j], PROFILE_COL_NAME_LEN - 1);
+            cols.encoding[j] = PROFILE_COL_DELTA_DOUBLE;
+            cols.col[j] = (double *) malloc((n_rows > 0 ? n_rows : 1)*sizeof(double));
+        }
+        size_t s = 0;
+        for (int b = 0; b < pe->n_bins; b++) {
+            const cs_real_t *mean = pe->mean + b*pe->n_vals;
+            if (mean[0] <= 0.)
+                continue;
+            cols.col[0][s] = (double)s;
+            for (int j = 1; j < pe->n_vals; j++)
+                cols.col[j][s] = mean[j];
+            s++;
+        }
+        ret = profile_columns_write(fName, &cols);
+        profile_columns_free(&cols);
+    }
+
+    if (ret == EXIT_SUCCESS)
+        bft_printf("Profile extraction: %lu rows, %d samples written to %s.\n",
+                   (unsigned long)n_rows, pe->n_samples, fName);
+    return ret;
+}
+
+
+void profile_extract_free(struct profile_extract_t* pe)
+{
+    BFT_FREE(pe->cell_bin);
+    BFT_FREE(pe->sums);
+    BFT_FREE(pe->mean);
+    memset(pe, 0, sizeof(struct profile_extract_t));
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,78 @@
+#ifndef PROFILE_EXTRACT_H
+#define PROFILE_EXTRACT_H
+
+#include "cs_defs.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Output of profile_extract_write() */
+enum profile_extract_format_t {
+    PROFILE_EXTRACT_CSV,        /* s,x,y,z,u,v,k,eps (or rxx..rxz) as in tmpUx.csv */
+    PROFILE_EXTRACT_BINARY      /* binary column file (profile_columns_write()) */
+};
+
+
+/**
+* Horizontally (plane) averaged vertical profiles computed in place.
+*
+* Cells are binned by the height of their center once (cell_bin); each
+* sample then accumulates volume weighted sums per bin and does a single
+* reduction to rank 0, which keeps the running time average.
+*/
+struct profile_extract_t {
+    int n_bins;
+    cs_real_t y_min, dy;
+    int rij;                    /* 1: Rij-epsilon columns, 0: k-epsilon */
+    int n_vals;                 /* values per bin: volume, x, y, z, then fields */
+
+    cs_lnum_t n_cells;          /* size of cell_bin (local cells at setup) */
+    int *cell_bin;              /* bin of each local cell, -1 if not selected */
+
+    cs_real_t *sums;            /* n_bins x n_vals, reduction buffer */
+    cs_real_t *mean;            /* n_bins x n_vals, time average (rank 0) */
+    int n_samples;
+};
+
+
+/**
+* Bin the cells of criteria (e.g. "all[]") into n_bins layers between
+* y_min and y_max (global extent of the selected cells if y_min >= y_max).
+* The turbulence model sets the columns (Rij-epsilon if itytur = 3).
+* Returns EXIT_FAILURE (reason logged) for other models than k-epsilon
+* and Rij-epsilon, no bin or no selected cell.
+*/
+int profile_extract_setup(const char *criteria,
+                          cs_real_t y_min,
+                          cs_real_t y_max,
+                          int n_bins,
+                          struct profile_extract_t* pe);
+
+/**
+* Add the current plane averages to the time average every "interval"
+* time steps (collective).
+*/
+void profile_extract_sample(struct profile_extract_t* pe, int interval);
+
+/**
+* Restart the time average (e.g. once the precursor is established).
+*/
+void profile_extract_reset(struct profile_extract_t* pe);
+
+/**
+* Write the time averaged profile (rank 0), one row per non-empty bin,
+* readable by read_profile_keps()/read_profile_SSG().
+*/
+int profile_extract_write(const struct profile_extract_t* pe,
+                          const char *fName,
+                          enum profile_extract_format_t format);
+
+void profile_extract_free(struct profile_extract_t* pe);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PROFILE_EXTRACT_H
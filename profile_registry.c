@@ -0,0 +1,499 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "cs_defs.h"
+
+#include "bft_mem.h"
+#include "bft_error.h"
+#include "bft_printf.h"
+
+#include "cs_boundary_zone.h"
+#include "cs_field.h"
+#include "cs_field_pointer.h"
+#include "cs_mesh.h"
+#include "cs_mesh_quantities.h"
+#include "cs_prototypes.h"
+#include "cs_selector.h"
+#include "cs_time_step.h"
+#include "cs_turbulence_model.h"
+
+#include "profile_analytic.h"
+#include "profile_shm.h"
+#include "profile_registry.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct _profile_source_t {
+    char file[256];
+    size_t num_lines;
+    int analytic;                   /* closed form, no file */
+    int simplify;
+    double tol[PROFILE_REGISTRY_MAX_VALS];  /* load-time simplification, record order */
+    struct profile_analytic_t param;
+    int loaded;
+    struct profile_shm_t storage;   /* one copy per node */
+    struct profile_keps_t keps;
+    struct profile_rijssg_t rij;
+};
+
+struct _profile_zone_t {
+    char name[128];
+    int source_id;
+    enum profile_interp_t interp;
+    int modulated;
+    struct tidal_modulation_t mod;  /* time scaling of the cached values */
+};
+
+static struct _profile_source_t _sources[PROFILE_REGISTRY_MAX_SOURCES];
+static struct _profile_zone_t _zones[PROFILE_REGISTRY_MAX_ZONES];
+static int _n_sources = 0;
+static int _n_zones = 0;
+static int _initial_source = -1;
+static int _defined = 0;
+static int _built = 0;
+
+/* Faces of all zones (increasing face id) and their cached values */
+static cs_lnum_t _n_faces = 0;
+static cs_lnum_t *_face_ids = NULL;
+static int _n_vals = 0;
+static int _ivar[PROFILE_REGISTRY_MAX_VALS];
+static int _val_exp[PROFILE_REGISTRY_MAX_VALS];  /* power of the velocity scale, 4: s st */
+static int *_face_zone = NULL;             /* zone entry of each face */
+static cs_real_t *_face_vals = NULL;       /* _n_faces x _n_vals */
+
+
+static void
+_load_source(int source_id)
+{
+    struct _profile_source_t *s = _sources + source_id;
+    int status = EXIT_SUCCESS;
+
+    if (s->loaded || s->analytic)
+        return;
+
+    if (cs_glob_turb_model->itytur == 3)
+        status = profile_shm_load_rijssg(s->file, s->num_lines,
+                                         s->simplify ? s->tol : NULL,
+                                         &(s->storage), &(s->rij));
+    else
+        status = profile_shm_load_keps(s->file, s->num_lines,
+                                       s->simplify ? s->tol : NULL,
+                                       &(s->storage), &(s->keps));
+
+    if (status != EXIT_SUCCESS)
+        bft_error(__FILE__, __LINE__, 0,
+                  "Error reading profile file \"%s\".\n", s->file);
+    s->loaded = 1;
+}
+
+static void
+_release_source(int source_id)
+{
+    struct _profile_source_t *s = _sources + source_id;
+    if (!s->loaded)
+        return;
+    profile_shm_free(&(s->storage));
+    s->keps.rec = NULL;
+    s->rij.rec = NULL;
+    s->loaded = 0;
+}
+
+static size_t
+_nearest_row(const double *y_rows, size_t stride, size_t n_rows, double y)
+{
+    size_t best = 0;
+    double d_best = HUGE_VAL;
+    for (size_t i = 0; i < n_rows; i++) {
+        double d = y_rows[i*stride] - y;
+        d = (d < 0.) ? -d : d;
+        if (d < d_best) {
+            d_best = d;
+            best = i;
+        }
+    }
+    return best;
+}
+
+/* Boundary values of one face, in the _ivar order */
+static void
+_source_values(int source_id, enum profile_interp_t interp,
+               cs_real_t y, cs_real_t *vals)
+{
+    struct _profile_source_t *s = _sources + source_id;
+
+    if (cs_glob_turb_model->itytur == 3) {
+        struct record_rijssg_t r;
+        if (s->analytic)
+            profile_analytic_eval_rijssg(&(s->param), 1, &y, &r);
+        else if (interp == PROFILE_INTERP_NEAREST)
+            r = s->rij.rec[_nearest_row(&(s->rij.rec[0].y),
+                                        sizeof(struct record_rijssg_t)/sizeof(double),
+                                        s->rij.n_rows, y)];
+        else
+            r = interpolate_rijssg(&(s->rij), y);
+        vals[0] = r.u;   vals[1] = r.v;   vals[2] = 0.;
+        vals[3] = r.rxx; vals[4] = r.ryy; vals[5] = r.rzz;
+        vals[6] = r.rxy; vals[7] = r.ryz; vals[8] = r.rxz;
+        vals[9] = r.eps;
+    }
+    else {
+        struct record_keps_t r;
+        if (s->analytic)
+            profile_analytic_eval_keps(&(s->param), 1, &y, &r);
+        else if (interp == PROFILE_INTERP_NEAREST)
+            r = s->keps.rec[_nearest_row(&(s->keps.rec[0].y),
+                                         sizeof(struct record_keps_t)/sizeof(double),
+                                         s->keps.n_rows, y)];
+        else
+            r = interpolate_keps(&(s->keps), y);
+        vals[0] = r.u; vals[1] = r.v; vals[2] = 0.;
+        vals[3] = r.k;
+        vals[4] = r.eps;
+    }
+}
+
+
+int profile_registry_add_file(const char *fName, size_t num_lines)
+{
+    for (int i = 0; i < _n_sources; i++)
+        if (strcmp(_sources[i].file, fName) == 0) {
+            if (num_lines > _sources[i].num_lines)
+                _sources[i].num_lines = num_lines;
+            return i;
+        }
+
+    if (_n_sources >= PROFILE_REGISTRY_MAX_SOURCES)
+        bft_error(__FILE__, __LINE__, 0,
+                  "Too many profile sources (max %d).\n", PROFILE_REGISTRY_MAX_SOURCES);
+
+    struct _profile_source_t *s = _sources + _n_sources;
+    memset(s, 0, sizeof(struct _profile_source_t));
+    strncpy(s->file, fName, sizeof(s->file) - 1);
+    s->num_lines = num_lines;
+    _built = 0;
+
+    return _n_sources++;
+}
+
+
+int profile_registry_set_tolerance(int source_id,
+                                   double tol_u,
+                                   double tol_turb,
+                                   double tol_eps)
+{
+    if (source_id < 0 || source_id >= _n_sources)
+        return EXIT_FAILURE;
+
+    struct _profile_source_t *s = _sources + source_id;
+    s->simplify = (tol_u > 0. || tol_turb > 0. || tol_eps > 0.);
+    s->tol[0] = s->tol[1] = tol_u;
+    if (cs_glob_turb_model->itytur == 3) {      //u, v, rxx..rxz, eps
+        for (int j = 2; j < 8; j++)
+            s->tol[j] = tol_turb;
+        s->tol[8] = tol_eps;
+    }
+    else {                                      //u, v, k, eps
+        s->tol[2] = tol_turb;
+        s->tol[3] = tol_eps;
+    }
+    _built = 0;
+    return EXIT_SUCCESS;
+}
+
+
+int profile_registry_add_analytic(const struct profile_analytic_t* param)
+{
+    if (_n_sources >= PROFILE_REGISTRY_MAX_SOURCES)
+        bft_error(__FILE__, __LINE__, 0,
+                  "Too many profile sources (max %d).\n", PROFILE_REGISTRY_MAX_SOURCES);
+
+    struct _profile_source_t *s = _sources + _n_sources;
+    memset(s, 0, sizeof(struct _profile_source_t));
+    snprintf(s->file, sizeof(s->file), "<analytic %d>", _n_sources);
+    s->analytic = 1;
+    s->param = *param;
+    _built = 0;
+
+    return _n_sources++;
+}
+
+
+void profile_registry_set_initial(int source_id)
+{
+    if (source_id < 0 || source_id >= _n_sources)
+        bft_error(__FILE__, __LINE__, 0,
+                  "Initial profile: undefined profile source %d.\n", source_id);
+    _initial_source = source_id;
+}
+
+
+int profile_registry_initial(void)
+{
+    profile_registry_define();
+    return _initial_source;
+}
+
+
+int profile_registry_add_zone(const char *zone_name,
+                              int source_id,
+                              enum profile_interp_t interp)
+{
+    if (_n_zones >= PROFILE_REGISTRY_MAX_ZONES)
+        bft_error(__FILE__, __LINE__, 0,
+                  "Too many profile zones (max %d).\n", PROFILE_REGISTRY_MAX_ZONES);
+    if (source_id < 0 || source_id >= _n_sources)
+        bft_error(__FILE__, __LINE__, 0,
+                  "Zone \"%s\": undefined profile source %d.\n", zone_name, source_id);
+
+    struct _profile_zone_t *z = _zones + _n_zones;
+    memset(z, 0, sizeof(struct _profile_zone_t));
+    strncpy(z->name, zone_name, sizeof(z->name) - 1);
+    z->source_id = source_id;
+    z->interp = interp;
+    _built = 0;
+
+    return _n_zones++;
+}
+
+
+void profile_registry_define(void)
+{
+    if (_defined)
+        return;
+    _defined = 1;
+    cs_user_profiles_define();
+}
+
+
+void profile_registry_build(void)
+{
+    const cs_mesh_t *m = cs_glob_mesh;
+    const cs_lnum_t n_b_faces = m->n_b_faces;
+    const cs_real_3_t *cell_cen
+        = (const cs_real_3_t *)cs_glob_mesh_quantities->cell_cen;
+    const int keyvar = cs_field_key_id("variable_id");
+    int *face_zone;
+    cs_lnum_t *list;
+
+    profile_registry_define();
+    if (_built)
+        return;
+
+    BFT_FREE(_face_ids);
+    BFT_FREE(_face_zone);
+    BFT_FREE(_face_vals);
+
+    /* Boundary condition variables, in the order of _source_values() */
+    {
+        int ivar_u = cs_field_get_key_int(CS_F_(u), keyvar) - 1;
+        _n_vals = 0;
+        for (int j = 0; j < 3; j++) {
+            _val_exp[_n_vals] = 1;
+            _ivar[_n_vals++] = ivar_u + j;
+        }
+        if (cs_glob_turb_model->itytur == 2) {
+            _val_exp[_n_vals] = 2;
+            _ivar[_n_vals++] = cs_field_get_key_int(CS_F_(k), keyvar) - 1;
+            _val_exp[_n_vals] = 3;
+            _ivar[_n_vals++] = cs_field_get_key_int(CS_F_(eps), keyvar) - 1;
+        }
+        else if (cs_glob_turb_model->itytur == 3) {
+            int ivar_r = cs_field_get_key_int(CS_F_(rij), keyvar) - 1;
+            for (int j = 0; j < 6; j++) {
+                /* xx, yy, zz, xy, yz, xz: the streamwise (x) shear stresses
+                   change sign with the flow, ryz does not */
+                _val_exp[_n_vals] = (j == 3 || j == 5) ? 4 : 2;
+                _ivar[_n_vals++] = ivar_r + j;
+            }
+            _val_exp[_n_vals] = 3;
+            _ivar[_n_vals++] = cs_field_get_key_int(CS_F_(eps), keyvar) - 1;
+        }
+    }
+
+    /* Face -> zone index (the last zone registered for a face wins) */
+    BFT_MALLOC(face_zone, n_b_faces, int);
+    BFT_MALLOC(list, n_b_faces, cs_lnum_t);
+    for (cs_lnum_t f = 0; f < n_b_faces; f++)
+        face_zone[f] = -1;
+
+    for (int z_id = 0; z_id < _n_zones; z_id++) {
+        const cs_boundary_zone_t *z = cs_boundary_zone_by_name_try(_zones[z_id].name);
+        const cs_lnum_t *ids = list;
+        cs_lnum_t n = 0;
+        if (z != NULL) {
+            ids = z->elt_ids;
+            n = z->n_elts;
+        }
+        else
+            cs_selector_get_b_face_list(_zones[z_id].name, &n, list);
+        for (cs_lnum_t i = 0; i < n; i++)
+            face_zone[ids[i]] = z_id;
+    }
+
+    _n_faces = 0;
+    for (cs_lnum_t f = 0; f < n_b_faces; f++)
+        if (face_zone[f] > -1)
+            list[_n_faces++] = f;
+    BFT_MALLOC(_face_ids, _n_faces, cs_lnum_t);
+    BFT_MALLOC(_face_zone, _n_faces, int);
+    memcpy(_face_ids, list, _n_faces*sizeof(cs_lnum_t));
+    for (cs_lnum_t i = 0; i < _n_faces; i++)
+        _face_zone[i] = face_zone[_face_ids[i]];
+    BFT_FREE(list);
+
+    /* Per-face values; each source is read once (collectively on all ranks,
+       in registration order, even if it has no local face) */
+    BFT_MALLOC(_face_vals, _n_faces*_n_vals, cs_real_t);
+    for (int s_id = 0; s_id < _n_sources; s_id++) {
+        int used = 0;
+        for (int z_id = 0; z_id < _n_zones; z_id++)
+            if (_zones[z_id].source_id == s_id)
+                used = 1;
+        if (!used)
+            continue;
+
+        _load_source(s_id);
+        for (cs_lnum_t i = 0; i < _n_faces; i++) {
+            cs_lnum_t f = _face_ids[i];
+            const struct _profile_zone_t *z = _zones + face_zone[f];
+            cs_real_t vals[PROFILE_REGISTRY_MAX_VALS];
+            if (z->source_id != s_id)
+                continue;
+            _source_values(s_id, z->interp, cell_cen[m->b_face_cells[f]][1], vals);
+            for (int j = 0; j < _n_vals; j++)
+                _face_vals[i*_n_vals + j] = vals[j];
+        }
+        _release_source(s_id);
+    }
+
+    BFT_FREE(face_zone);
+    _built = 1;
+}
+
+
+void profile_registry_apply(int bc_type[],
+                            int icodcl[],
+                            cs_real_t rcodcl[])
+{
+    const cs_lnum_t n_b_faces = cs_glob_mesh->n_b_faces;
+    cs_real_t scale[PROFILE_REGISTRY_MAX_ZONES][5];
+    int modulated = 0;
+
+    profile_registry_build();
+
+    for (cs_lnum_t i = 0; i < _n_faces; i++)
+        bc_type[_face_ids[i]] = CS_INLET;
+
+    /* Velocity scale of each zone at the current time: u x s, k, Rii and
+       ryz x st^2, rxy and rxz x s st, eps x st^3, st = max(|s|, turb_min) */
+    for (int z_id = 0; z_id < _n_zones; z_id++) {
+        cs_real_t s = 1., st = 1.;
+        if (_zones[z_id].modulated) {
+            s = tidal_modulation_eval(&(_zones[z_id].mod), cs_glob_time_step->t_cur);
+            st = CS_MAX(CS_ABS(s), _zones[z_id].mod.turb_min);
+            modulated = 1;
+        }
+        scale[z_id][0] = 1.;
+        scale[z_id][1] = s;
+        scale[z_id][2] = st*st;
+        scale[z_id][3] = st*st*st;
+        scale[z_id][4] = s*st;
+    }
+
+    for (int j = 0; j < _n_vals; j++) {
+        int *icod = icodcl + (cs_lnum_t)_ivar[j]*n_b_faces;
+        cs_real_t *rcod = rcodcl + (cs_lnum_t)_ivar[j]*n_b_faces;
+        if (modulated) {
+            const int e = _val_exp[j];
+            for (cs_lnum_t i = 0; i < _n_faces; i++) {
+                icod[_face_ids[i]] = 1;
+                rcod[_face_ids[i]] = _face_vals[i*_n_vals + j]*scale[_face_zone[i]][e];
+            }
+        }
+        else {
+            for (cs_lnum_t i = 0; i < _n_faces; i++) {
+                icod[_face_ids[i]] = 1;                             //Dirichlet value
+                rcod[_face_ids[i]] = _face_vals[i*_n_vals + j];     //Value
+            }
+        }
+    }
+}
+
+
+int profile_registry_set_modulation(int zone_id,
+                                    const struct tidal_modulation_t* mod)
+{
+    if (zone_id < 0 || zone_id >= _n_zones)
+        return EXIT_FAILURE;
+    _zones[zone_id].modulated = (mod != NULL);
+    if (mod != NULL)
+        _zones[zone_id].mod = *mod;
+    return EXIT_SUCCESS;
+}
+
+
+int profile_registry_eval_keps(int source_id,
+                               cs_lnum_t n,
+                               const cs_real_t y[],
+                               struct record_keps_t out[])
+{
+    if (source_id < 0 || source_id >= _n_sources)
+        return EXIT_FAILURE;
+    if (_sources[source_id].analytic) {
+        profile_analytic_eval_keps(&(_sources[source_id].param), n, y, out);
+        return EXIT_SUCCESS;
+    }
+    if (cs_glob_turb_model->itytur == 3)
+        return EXIT_FAILURE;
+
+    _load_source(source_id);
+    for (cs_lnum_t i = 0; i < n; i++)
+        out[i] = interpolate_keps(&(_sources[source_id].keps), y[i]);
+    _release_source(source_id);
+
+    return EXIT_SUCCESS;
+}
+
+
+int profile_registry_eval_rijssg(int source_id,
+                                 cs_lnum_t n,
+                                 const cs_real_t y[],
+                                 struct record_rijssg_t out[])
+{
+    if (source_id < 0 || source_id >= _n_sources)
+        return EXIT_FAILURE;
+    if (_sources[source_id].analytic) {
+        profile_analytic_eval_rijssg(&(_sources[source_id].param), n, y, out);
+        return EXIT_SUCCESS;
+    }
+    if (cs_glob_turb_model->itytur != 3)
+        return EXIT_FAILURE;
+
+    _load_source(source_id);
+    for (cs_lnum_t i = 0; i < n; i++)
+        out[i] = interpolate_rijssg(&(_sources[source_id].rij), y[i]);
+    _release_source(source_id);
+
+    return EXIT_SUCCESS;
+}
+
+
+void profile_registry_finalize(void)
+{
+    for (int s_id = 0; s_id < _n_sources; s_id++)
+        _release_source(s_id);
+    BFT_FREE(_face_ids);
+    BFT_FREE(_face_zone);
+    BFT_FREE(_face_vals);
+    _n_faces = 0;
+    _built = 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,129 @@
+#ifndef PROFILE_REGISTRY_H
+#define PROFILE_REGISTRY_H
+
+#include "cs_defs.h"
+
+#include "read_from_ke_profile.h"
+#include "read_from_rije_profile.h"
+#include "profile_analytic.h"
+#include "tidal_modulation.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PROFILE_REGISTRY_MAX_SOURCES 16
+#define PROFILE_REGISTRY_MAX_ZONES 16
+#define PROFILE_REGISTRY_MAX_VALS 10        /* velocity (3) + Rij (6) + eps */
+
+
+/* How a profile is evaluated at the height of a boundary face */
+enum profile_interp_t {
+    PROFILE_INTERP_LINEAR,      /* linear interpolation between table rows */
+    PROFILE_INTERP_NEAREST      /* value of the closest table row */
+};
+
+
+/**
+* Register a table profile source (CSV or binary column file).
+* A file registered several times is loaded only once.
+* Returns the source id.
+*/
+int profile_registry_add_file(const char *fName, size_t num_lines);
+
+/**
+* Simplify a table source at load time (Douglas-Peucker): rows are
+* dropped while the linear interpolation stays within tol_u for u and v,
+* tol_turb for k or Rij and tol_eps for eps (<= 0: column not checked,
+* all <= 0: no simplification).
+*/
+int profile_registry_set_tolerance(int source_id,
+                                   double tol_u,
+                                   double tol_turb,
+                                   double tol_eps);
+
+/**
+* Register a closed-form profile source (log law, power law), evaluated
+* without any file I/O. Returns the source id.
+*/
+int profile_registry_add_analytic(const struct profile_analytic_t* param);
+
+/**
+* Source used by cs_user_initialization() for the initial fields.
+*/
+void profile_registry_set_initial(int source_id);
+
+/**
+* Initial field source (calls the case setup if needed), -1 if none.
+*/
+int profile_registry_initial(void);
+
+/**
+* Impose the profile of source_id on a boundary zone.
+* zone_name is a cs_boundary_zone name, or a selection criteria
+* (e.g. "inlet or outlet") if no zone has that name.
+* Returns the zone entry id.
+*/
+int profile_registry_add_zone(const char *zone_name,
+                              int source_id,
+                              enum profile_interp_t interp);
+
+/**
+* Scale the cached values of a zone entry each time step by the harmonic
+* modulation s(t): velocity x s, k, the normal stresses and ryz x s_t^2,
+* rxy and rxz x s s_t, eps x s_t^3, with s_t = max(|s|, mod->turb_min).
+* rxy and rxz change sign (continuously) with the streamwise flow, ryz
+* is not affected by a reversal along x.
+* mod == NULL removes the modulation.
+*/
+int profile_registry_set_modulation(int zone_id,
+                                    const struct tidal_modulation_t* mod);
+
+/**
+* Call the case setup (cs_user_profiles_define()) once.
+*/
+void profile_registry_define(void);
+
+/**
+* Build the face -> zone index and the per-face values of all zones.
+* Called automatically by profile_registry_apply().
+*/
+void profile_registry_build(void);
+
+/**
+* Set bc_type/icodcl/rcodcl for the faces of all registered zones,
+* in a single pass over the precomputed face list.
+*/
+void profile_registry_apply(int bc_type[],
+                            int icodcl[],
+                            cs_real_t rcodcl[]);
+
+/**
+* Evaluate a source at n heights y. Table sources are read according to the
+* turbulence model: k-epsilon records, or Rij-epsilon records (itytur = 3);
+* analytic sources give both kinds of records.
+*/
+int profile_registry_eval_keps(int source_id,
+                               cs_lnum_t n,
+                               const cs_real_t y[],
+                               struct record_keps_t out[]);
+
+int profile_registry_eval_rijssg(int source_id,
+                                 cs_lnum_t n,
+                                 const cs_real_t y[],
+                                 struct record_rijssg_t out[]);
+
+/**
+* Release the loaded sources and cached face values.
+*/
+void profile_registry_finalize(void);
+
+/* Case setup, defined in cs_user_profiles.c */
+void cs_user_profiles_define(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PROFILE_REGISTRY_H
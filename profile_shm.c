@@ -0,0 +1,328 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "cs_defs.h"
+
+#include "bft_mem.h"
+#include "bft_error.h"
+#include "bft_printf.h"
+
+#include "profile_simplify.h"
+#include "profile_shm.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Header stored in front of the profile records in the shared block,
+   padded so that the records stay cache-line aligned */
+#define PROFILE_SHM_HEADER_SIZE 64
+
+struct profile_shm_header_t {
+    size_t n_rows;
+    int status;
+};
+
+#if defined(HAVE_MPI)
+
+static MPI_Comm _node_comm = MPI_COMM_NULL;
+static int _n_segments = 0;
+
+/*
+* Communicator grouping the ranks of the current node, built once.
+* Without MPI-3 the ranks are grouped by processor name.
+*/
+static MPI_Comm
+_profile_shm_node_comm(void)
+{
+    if (_node_comm != MPI_COMM_NULL)
+        return _node_comm;
+
+#if MPI_VERSION >= 3
+    MPI_Comm_split_type(cs_glob_mpi_comm, MPI_COMM_TYPE_SHARED,
+                        cs_glob_rank_id, MPI_INFO_NULL, &_node_comm);
+#else
+    char host[MPI_MAX_PROCESSOR_NAME];
+    int len = 0;
+    unsigned int color = 5381;
+    MPI_Get_processor_name(host, &len);
+    for (int i = 0; i < len; i++)
+        color = color*33 + (unsigned char)host[i];
+    MPI_Comm_split(cs_glob_mpi_comm, (int)(color & 0x7fffffff),
+                   cs_glob_rank_id, &_node_comm);
+#endif
+
+    return _node_comm;
+}
+
+#if MPI_VERSION < 3
+
+/*
+* POSIX segment created by the node root, mapped read-only by the others.
+*/
+static int
+_profile_shm_alloc_posix(size_t size, struct profile_shm_t* shm)
+{
+    int fd = -1;
+    int ok = 1;
+
+    if (shm->is_writer) {
+        snprintf(shm->name, sizeof(shm->name), "/cs_profile_%ld_%d",
+                 (long)getpid(), _n_segments);
+        fd = shm_open(shm->name, O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0 || ftruncate(fd, (off_t)size) != 0)
+            ok = 0;
+    }
+    MPI_Bcast(shm->name, sizeof(shm->name), MPI_CHAR, 0, shm->node_comm);
+    MPI_Bcast(&ok, 1, MPI_INT, 0, shm->node_comm);
+    if (!ok) {
+        if (fd >= 0) {
+            close(fd);
+            shm_unlink(shm->name);
+        }
+        return EXIT_FAILURE;
+    }
+
+    if (shm->is_writer) {
+        shm->data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    else {
+        fd = shm_open(shm->name, O_RDONLY, 0);
+        shm->data = (fd < 0) ? MAP_FAILED
+                             : mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    if (fd >= 0)
+        close(fd);
+
+    ok = (shm->data != MAP_FAILED);
+    MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_MIN, shm->node_comm);
+
+    /* Everybody is attached (or failed): the name is no longer needed,
+       the segment disappears with the last mapping */
+    if (shm->is_writer)
+        shm_unlink(shm->name);
+
+    if (!ok) {
+        if (shm->data != MAP_FAILED)
+            munmap(shm->data, size);
+        shm->data = NULL;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+#endif /* MPI_VERSION < 3 */
+
+
+MPI_Comm profile_shm_node_comm(void)
+{
+    return _profile_shm_node_comm();
+}
+
+#endif /* HAVE_MPI */
+
+
+int profile_shm_alloc(size_t size, struct profile_shm_t* shm)
+{
+    int node_size = 1;
+
+    memset(shm, 0, sizeof(struct profile_shm_t));
+    shm->size = size;
+    shm->is_writer = 1;
+    shm->mode = PROFILE_SHM_HEAP;
+
+#if defined(HAVE_MPI)
+    shm->node_comm = MPI_COMM_NULL;
+    shm->win = MPI_WIN_NULL;
+
+    if (cs_glob_n_ranks > 1) {
+        int node_rank;
+        shm->node_comm = _profile_shm_node_comm();
+        MPI_Comm_rank(shm->node_comm, &node_rank);
+        MPI_Comm_size(shm->node_comm, &node_size);
+        shm->is_writer = (node_rank == 0);
+    }
+
+    if (node_size > 1) {
+        _n_segments++;
+
+#if MPI_VERSION >= 3
+        MPI_Aint win_size = shm->is_writer ? (MPI_Aint)size : 0;
+        MPI_Aint q_size;
+        int disp_unit;
+
+        shm->mode = PROFILE_SHM_MPI_WIN;
+        MPI_Win_allocate_shared(win_size, 1, MPI_INFO_NULL, shm->node_comm,
+                                &(shm->data), &(shm->win));
+        MPI_Win_shared_query(shm->win, 0, &q_size, &disp_unit, &(shm->data));
+        MPI_Win_fence(0, shm->win);     /* open the epoch the writer fills in */
+        return EXIT_SUCCESS;
+#else
+        shm->mode = PROFILE_SHM_POSIX;
+        if (_profile_shm_alloc_posix(size, shm) == EXIT_SUCCESS)
+            return EXIT_SUCCESS;
+
+        /* No shared segment on this node (same outcome on all its ranks):
+           every rank keeps a private copy */
+        bft_printf("Profile storage: no POSIX shared memory, using a copy per rank.\n");
+        shm->mode = PROFILE_SHM_HEAP;
+        shm->is_writer = 1;
+#endif
+    }
+#endif /* HAVE_MPI */
+
+    BFT_MALLOC(shm->data, size, char);
+    return (shm->data != NULL) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+void profile_shm_finalize(void)
+{
+#if defined(HAVE_MPI)
+    if (_node_comm != MPI_COMM_NULL)
+        MPI_Comm_free(&_node_comm);
+#endif
+}
+
+
+void profile_shm_sync(struct profile_shm_t* shm)
+{
+#if defined(HAVE_MPI)
+    if (shm->mode == PROFILE_SHM_MPI_WIN)
+        MPI_Win_fence(0, shm->win);
+    else if (shm->mode == PROFILE_SHM_POSIX)
+        MPI_Barrier(shm->node_comm);
+#else
+    CS_UNUSED(shm);
+#endif
+}
+
+
+void profile_shm_free(struct profile_shm_t* shm)
+{
+    if (shm->data == NULL)
+        return;
+
+    switch (shm->mode) {
+#if defined(HAVE_MPI)
+    case PROFILE_SHM_MPI_WIN:
+        MPI_Win_free(&(shm->win));
+        break;
+    case PROFILE_SHM_POSIX:
+        munmap(shm->data, shm->size);
+        break;
+#endif
+    default:
+        BFT_FREE(shm->data);
+    }
+
+    shm->data = NULL;
+    shm->size = 0;
+}
+
+
+/* Simplified profile summary (bft_printf only writes on rank 0) */
+static void
+_log_simplify(const char *fName, size_t n_rows, size_t n_kept,
+              int n_cols, const char **names, const double max_err[])
+{
+    bft_printf("Profile \"%s\": %lu -> %lu rows, max error",
+               fName, (unsigned long)n_rows, (unsigned long)n_kept);
+    for (int j = 0; j < n_cols; j++)
+        bft_printf(" %s %.3g", names[j], max_err[j]);
+    bft_printf("\n");
+}
+
+
+int profile_shm_load_keps(const char *fName, size_t num_lines,
+                          const double *tol,
+                          struct profile_shm_t* shm,
+                          struct profile_keps_t* rows)
+{
+    struct profile_shm_header_t* hdr;
+    size_t size = PROFILE_SHM_HEADER_SIZE + num_lines*sizeof(struct record_keps_t);
+
+    if (profile_shm_alloc(size, shm) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+
+    hdr = (struct profile_shm_header_t *) shm->data;
+    rows->rec = (struct record_keps_t *) ((char *)shm->data + PROFILE_SHM_HEADER_SIZE);
+
+    if (shm->is_writer) {
+        rows->n_rows = num_lines;
+        hdr->status = read_profile_keps(fName, num_lines, rows);
+        if (hdr->status == EXIT_SUCCESS && tol != NULL) {
+            static const char *names[] = {"u", "v", "k", "eps"};
+            double max_err[4];
+            size_t n_rows = rows->n_rows;
+            profile_simplify_keps(rows, tol, max_err);
+            _log_simplify(fName, n_rows, rows->n_rows, 4, names, max_err);
+        }
+        hdr->n_rows = rows->n_rows;
+        if (hdr->n_rows == 0)
+            hdr->status = EXIT_FAILURE;
+    }
+    profile_shm_sync(shm);
+
+    rows->n_rows = hdr->n_rows;
+    if (hdr->status != EXIT_SUCCESS) {
+        profile_shm_free(shm);
+        rows->rec = NULL;
+        rows->n_rows = 0;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+
+int profile_shm_load_rijssg(const char *fName, size_t num_lines,
+                            const double *tol,
+                            struct profile_shm_t* shm,
+                            struct profile_rijssg_t* rows)
+{
+    struct profile_shm_header_t* hdr;
+    size_t size = PROFILE_SHM_HEADER_SIZE + num_lines*sizeof(struct record_rijssg_t);
+
+    if (profile_shm_alloc(size, shm) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+
+    hdr = (struct profile_shm_header_t *) shm->data;
+    rows->rec = (struct record_rijssg_t *) ((char *)shm->data + PROFILE_SHM_HEADER_SIZE);
+
+    if (shm->is_writer) {
+        rows->n_rows = num_lines;
+        hdr->status = read_profile_SSG(fName, num_lines, rows);
+        if (hdr->status == EXIT_SUCCESS && tol != NULL) {
+            static const char *names[] = {"u", "v", "rxx", "ryy", "rzz",
+                                          "rxy", "ryz", "rxz", "eps"};
+            double max_err[9];
+            size_t n_rows = rows->n_rows;
+            profile_simplify_rijssg(rows, tol, max_err);
+            _log_simplify(fName, n_rows, rows->n_rows, 9, names, max_err);
+        }
+        hdr->n_rows = rows->n_rows;
+        if (hdr->n_rows == 0)
+            hdr->status = EXIT_FAILURE;
+    }
+    profile_shm_sync(shm);
+
+    rows->n_rows = hdr->n_rows;
+    if (hdr->status != EXIT_SUCCESS) {
+        profile_shm_free(shm);
+        rows->rec = NULL;
+        rows->n_rows = 0;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,96 @@
+#ifndef PROFILE_SHM_H
+#define PROFILE_SHM_H
+
+#include "cs_defs.h"
+
+#include "read_from_ke_profile.h"
+#include "read_from_rije_profile.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/* Kind of storage backing a shared profile */
+enum profile_shm_mode_t {
+    PROFILE_SHM_HEAP,       /* private heap copy (serial run or single rank on node) */
+    PROFILE_SHM_MPI_WIN,    /* MPI-3 shared memory window */
+    PROFILE_SHM_POSIX       /* POSIX shm_open/mmap segment */
+};
+
+
+/**
+* Node-level storage block.
+* Allocated once per node, written by a single rank (is_writer == 1),
+* all other ranks of the node only get a read-only view of "data".
+*/
+struct profile_shm_t {
+    enum profile_shm_mode_t mode;
+    size_t size;            /* size of the block in bytes */
+    void *data;             /* start of the block (same content on all node ranks) */
+    int is_writer;          /* 1 on the rank in charge of filling the block */
+#if defined(HAVE_MPI)
+    MPI_Comm node_comm;
+    MPI_Win win;
+#endif
+    char name[64];          /* POSIX segment name */
+};
+
+
+/**
+* Allocate a block of "size" bytes shared by all ranks of the node.
+* If the node has no shared memory segment, each rank gets a private
+* heap block and is its own writer.
+* Collective over the ranks of the node.
+*/
+int profile_shm_alloc(size_t size, struct profile_shm_t* shm);
+
+#if defined(HAVE_MPI)
+/**
+* Communicator of the ranks of the current node (built once, freed by
+* profile_shm_finalize()).
+*/
+MPI_Comm profile_shm_node_comm(void);
+#endif
+
+/**
+* Free the node communicator, once the blocks and the other users of
+* profile_shm_node_comm() are released. Collective.
+*/
+void profile_shm_finalize(void);
+
+/**
+* Make the data written by the writer rank visible to the node ranks.
+* Collective over the ranks of the node.
+*/
+void profile_shm_sync(struct profile_shm_t* shm);
+
+/**
+* Release the block. Collective over the ranks of the node.
+*/
+void profile_shm_free(struct profile_shm_t* shm);
+
+/**
+* Read a profile once per node into shared storage.
+* On return rows->rec points into the shared block and rows->n_rows
+* holds the number of lines actually read (at most num_lines).
+* If tol is not NULL the writer rank simplifies the table with these
+* per-column tolerances (see profile_simplify_keps/rijssg) before
+* publishing it, and logs the row counts and the achieved error.
+*/
+int profile_shm_load_keps(const char *fName, size_t num_lines,
+                          const double *tol,
+                          struct profile_shm_t* shm,
+                          struct profile_keps_t* rows);
+
+int profile_shm_load_rijssg(const char *fName, size_t num_lines,
+                            const double *tol,
+                            struct profile_shm_t* shm,
+                            struct profile_rijssg_t* rows);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PROFILE_SHM_H
@@ -0,0 +1,124 @@
+#include <stdlib.h>
+#include <string.h>
+#include "profile_simplify.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Interpolation errors of row i on the segment [a, b], relative to tol
+   (returns the largest one); absolute errors are accumulated in err */
+static double
+_row_error(const double *rec, size_t stride, int n_cols, const double tol[],
+           size_t a, size_t i, size_t b, double err[])
+{
+    const double *ra = rec + a*stride, *ri = rec + i*stride, *rb = rec + b*stride;
+    const double dy = rb[0] - ra[0];
+    const double t = (dy != 0.) ? (ri[0] - ra[0])/dy : 0.;
+    double e_max = 0.;
+
+    for (int j = 1; j <= n_cols; j++) {
+        double e = ri[j] - (ra[j] + t*(rb[j] - ra[j]));
+        e = (e < 0.) ? -e : e;
+        if (err != NULL && e > err[j-1])
+            err[j-1] = e;
+        if (tol[j-1] > 0. && e > e_max*tol[j-1])
+            e_max = e/tol[j-1];
+    }
+    return e_max;
+}
+
+
+size_t profile_simplify(double *rec,
+                        size_t stride,
+                        size_t n_rows,
+                        int n_cols,
+                        const double tol[],
+                        double max_err[])
+{
+    if (max_err != NULL)
+        for (int j = 0; j < n_cols; j++)
+            max_err[j] = 0.;
+    if (n_rows < 3)
+        return n_rows;
+
+    unsigned char *keep = (unsigned char *) calloc(n_rows, 1);
+    size_t *stack = (size_t *) malloc(2*n_rows*sizeof(size_t));
+    size_t n_stack = 0;
+
+    keep[0] = keep[n_rows-1] = 1;
+    stack[n_stack++] = 0;
+    stack[n_stack++] = n_rows - 1;
+
+    /* Split the segments where the worst row exceeds a tolerance */
+    while (n_stack > 0) {
+        size_t b = stack[--n_stack];
+        size_t a = stack[--n_stack];
+        size_t i_max = a;
+        double e_max = 1.;
+
+        for (size_t i = a + 1; i < b; i++) {
+            double e = _row_error(rec, stride, n_cols, tol, a, i, b, NULL);
+            if (e > e_max) {
+                e_max = e;
+                i_max = i;
+            }
+        }
+        if (i_max > a) {
+            keep[i_max] = 1;
+            stack[n_stack++] = a;
+            stack[n_stack++] = i_max;
+            stack[n_stack++] = i_max;
+            stack[n_stack++] = b;
+        }
+    }
+
+    /* Achieved error over the removed rows */
+    if (max_err != NULL) {
+        size_t a = 0;
+        for (size_t b = 1; b < n_rows; b++) {
+            if (!keep[b])
+                continue;
+            for (size_t i = a + 1; i < b; i++)
+                _row_error(rec, stride, n_cols, tol, a, i, b, max_err);
+            a = b;
+        }
+    }
+
+    size_t n = 0;
+    for (size_t i = 0; i < n_rows; i++)
+        if (keep[i]) {
+            if (n < i)
+                memcpy(rec + n*stride, rec + i*stride, stride*sizeof(double));
+            n++;
+        }
+
+    free(stack);
+    free(keep);
+    return n;
+}
+
+
+void profile_simplify_keps(struct profile_keps_t* rows,
+                           const double tol[4],
+                           double max_err[4])
+{
+    rows->n_rows = profile_simplify(&(rows->rec[0].y),
+                                    sizeof(struct record_keps_t)/sizeof(double),
+                                    rows->n_rows, 4, tol, max_err);
+}
+
+
+void profile_simplify_rijssg(struct profile_rijssg_t* rows,
+                             const double tol[9],
+                             double max_err[9])
+{
+    rows->n_rows = profile_simplify(&(rows->rec[0].y),
+                                    sizeof(struct record_rijssg_t)/sizeof(double),
+                                    rows->n_rows, 9, tol, max_err);
+}
+
+#ifdef __cplusplus
+}
+#endif
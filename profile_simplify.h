@@ -0,0 +1,48 @@
+#ifndef PROFILE_SIMPLIFY_H
+#define PROFILE_SIMPLIFY_H
+
+#include <stddef.h>
+
+#include "read_from_ke_profile.h"
+#include "read_from_rije_profile.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+* Douglas-Peucker reduction of a table of records made of doubles:
+* y at rec[i*stride], then n_cols values. A row is kept only if the
+* linear interpolation between its retained neighbours would differ
+* from one of its values by more than the column tolerance
+* (columns with tol <= 0 are not checked).
+* The kept rows are compacted in place (order preserved, first and last
+* rows always kept); max_err[j] (may be NULL) receives the largest
+* interpolation error of column j over the removed rows.
+* Returns the new number of rows.
+*/
+size_t profile_simplify(double *rec,
+                        size_t stride,
+                        size_t n_rows,
+                        int n_cols,
+                        const double tol[],
+                        double max_err[]);
+
+/**
+* Same on profile records, tol and max_err in record order:
+* u, v, k, eps (resp. u, v, rxx, ryy, rzz, rxy, ryz, rxz, eps).
+*/
+void profile_simplify_keps(struct profile_keps_t* rows,
+                           const double tol[4],
+                           double max_err[4]);
+
+void profile_simplify_rijssg(struct profile_rijssg_t* rows,
+                             const double tol[9],
+                             double max_err[9]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PROFILE_SIMPLIFY_H
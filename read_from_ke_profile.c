@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "read_from_ke_profile.h"
+#include "profile_columns.h"
 
 
 #ifdef __cplusplus
@@ -86,48 +87,18 @@ interpolate_keps(struct profile_keps_t* rows, double y_new)
 }
 
 int read_profile_keps(const char *fName, size_t num_lines, struct profile_keps_t* rows) {
-    FILE* stream = fopen(fName, "r");
-    if (stream == NULL)
-            return EXIT_FAILURE;
-    char line[1024];
-
-    const char *tok;
-    size_t line_count = 0;
-    size_t i=0;
-    fgets(line, 1024, stream);          //read header
-    while (fgets(line, 1024, stream) != NULL){
-        //put everything in profile
-        tok = strtok(line, ",");                //"s"
-        //skip
-
-        tok = strtok(NULL, ",");                //"x"
-        //skip
-
-        tok = strtok(NULL, ",");                //"y"
-        rows->rec[i].y = atof(tok);
-
-        tok = strtok(NULL, ",");                //"z"
-        //skip
-
-        tok = strtok(NULL, ",");                //"u"
-        rows->rec[i].u = atof(tok);
-
-        tok = strtok(NULL, ",");                //"v"
-        rows->rec[i].v = atof(tok);
-
-        tok = strtok(NULL, ",");                //"k"
-        rows->rec[i].k = atof(tok);
-
-        tok = strtok(NULL, ",");                //"eps"
-        rows->rec[i].eps = atof(tok);
-
-        i++;
-        if (++line_count >= num_lines)
-          break;
-    }
-    fclose(stream);
-    return EXIT_SUCCESS;
-
+    struct profile_columns_t cols;
+    int status;
+
+    memset(&cols, 0, sizeof(struct profile_columns_t));
+    if (profile_columns_is_binary(fName))       //binary (compressed) column file
+        status = profile_columns_read(fName, &cols);
+    else                                        //CSV, parsed in parallel by chunks
+        status = profile_columns_read_csv_rows(fName, num_lines, &cols);
+    if (status == EXIT_SUCCESS)
+        status = profile_columns_to_keps(&cols, num_lines, rows);
+    profile_columns_free(&cols);
+    return status;
 }
 
 //int read_profile_keps(const char *fName, size_t num_lines, struct profile_keps_t* rows) {
@@ -0,0 +1,470 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "cs_defs.h"
+
+#include "bft_mem.h"
+#include "bft_error.h"
+#include "bft_printf.h"
+
+#include "cs_mesh.h"
+#include "cs_mesh_quantities.h"
+#include "cs_selector.h"
+
+#include "recycle_inflow.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Uniform 2D bucket grid over the candidate donor cells,
+   in the plane orthogonal to the recycling direction */
+struct _donor_grid_t {
+    int nx, ny;
+    cs_real_t min[2], h[2];
+    cs_lnum_t *start;           /* size nx*ny + 1 */
+    cs_lnum_t *items;           /* candidate ids, bucket by bucket */
+};
+
+static void
+_plane_axes(const cs_real_t e[3], cs_real_t a[3], cs_real_t b[3])
+{
+    /* a: any unit vector orthogonal to e, b = e x a */
+    cs_real_t t[3] = {0., 0., 0.};
+    t[(fabs(e[0]) < 0.9) ? 0 : 1] = 1.;
+    cs_real_t d = t[0]*e[0] + t[1]*e[1] + t[2]*e[2];
+    for (int i = 0; i < 3; i++)
+        a[i] = t[i] - d*e[i];
+    d = sqrt(a[0]*a[0] + a[1]*a[1] + a[2]*a[2]);
+    for (int i = 0; i < 3; i++)
+        a[i] /= d;
+    b[0] = e[1]*a[2] - e[2]*a[1];
+    b[1] = e[2]*a[0] - e[0]*a[2];
+    b[2] = e[0]*a[1] - e[1]*a[0];
+}
+
+static void
+_donor_grid_build(cs_lnum_t n, const cs_real_t *uv, struct _donor_grid_t* g)
+{
+    cs_real_t max[2];
+    int n_bins = (int)sqrt((double)n) + 1;
+
+    g->min[0] = g->min[1] = HUGE_VAL;
+    max[0] = max[1] = -HUGE_VAL;
+    for (cs_lnum_t i = 0; i < n; i++) {
+        for (int j = 0; j < 2; j++) {
+            if (uv[2*i+j] < g->min[j]) g->min[j] = uv[2*i+j];
+            if (uv[2*i+j] > max[j]) max[j] = uv[2*i+j];
+        }
+    }
+    g->nx = g->ny = n_bins;
+    g->h[0] = (max[0] - g->min[0])/n_bins;
+    g->h[1] = (max[1] - g->min[1])/n_bins;
+    for (int j = 0; j < 2; j++)
+        if (g->h[j] <= 0.) g->h[j] = 1.;
+
+    BFT_MALLOC(g->start, g->nx*g->ny + 1, cs_lnum_t);
+    BFT_MALLOC(g->items, n, cs_lnum_t);
+    memset(g->start, 0, (g->nx*g->ny + 1)*sizeof(cs_lnum_t));
+
+    cs_lnum_t *bin_id;
+    BFT_MALLOC(bin_id, n, cs_lnum_t);
+    for (cs_lnum_t i = 0; i < n; i++) {
+        int ix = (int)((uv[2*i] - g->min[0])/g->h[0]);
+        int iy = (int)((uv[2*i+1] - g->min[1])/g->h[1]);
+        ix = CS_MIN(CS_MAX(ix, 0), g->nx - 1);
+        iy = CS_MIN(CS_MAX(iy, 0), g->ny - 1);
+        bin_id[i] = iy*g->nx + ix;
+        g->start[bin_id[i] + 1] += 1;
+    }
+    for (int b = 0; b < g->nx*g->ny; b++)
+        g->start[b+1] += g->start[b];
+
+    cs_lnum_t *pos;
+    BFT_MALLOC(pos, g->nx*g->ny, cs_lnum_t);
+    memcpy(pos, g->start, g->nx*g->ny*sizeof(cs_lnum_t));
+    for (cs_lnum_t i = 0; i < n; i++)
+        g->items[pos[bin_id[i]]++] = i;
+
+    BFT_FREE(pos);
+    BFT_FREE(bin_id);
+}
+
+/* Closest candidate (3D distance) to point q of plane coordinates quv */
+static cs_lnum_t
+_donor_grid_closest(const struct _donor_grid_t* g,
+                    const cs_real_t *xyz,
+                    const cs_real_t quv[2],
+                    const cs_real_t q[3])
+{
+    cs_lnum_t best = -1;
+    cs_real_t best_d2 = HUGE_VAL;
+    cs_real_t h_min = CS_MIN(g->h[0], g->h[1]);
+    int ix = (int)((quv[0] - g->min[0])/g->h[0]);
+    int iy = (int)((quv[1] - g->min[1])/g->h[1]);
+    int r_max = CS_MAX(g->nx, g->ny);
+
+    ix = CS_MIN(CS_MAX(ix, 0), g->nx - 1);
+    iy = CS_MIN(CS_MAX(iy, 0), g->ny - 1);
+
+    for (int r = 0; r <= r_max; r++) {
+        for (int jy = iy - r; jy <= iy + r; jy++) {
+            if (jy < 0 || jy >= g->ny) continue;
+            for (int jx = ix - r; jx <= ix + r; jx++) {
+                if (jx < 0 || jx >= g->nx) continue;
+                if (CS_ABS(jx - ix) != r && CS_ABS(jy - iy) != r) continue;
+                int b = jy*g->nx + jx;
+                for (cs_lnum_t k = g->start[b]; k < g->start[b+1]; k++) {
+                    cs_lnum_t i = g->items[k];
+                    cs_real_t d2 = 0.;
+                    for (int j = 0; j < 3; j++)
+                        d2 += (xyz[3*i+j] - q[j])*(xyz[3*i+j] - q[j]);
+                    if (d2 < best_d2) {
+                        best_d2 = d2;
+                        best = i;
+                    }
+                }
+            }
+        }
+        /* anything in further rings is at least r*h_min away in the plane */
+        if (best >= 0 && best_d2 <= (r*h_min)*(r*h_min))
+            break;
+    }
+    return best;
+}
+
+
+int recycle_inflow_setup(const char *inlet_criteria,
+                         const cs_real_t shift[3],
+                         cs_real_t slab,
+                         cs_real_t y_wall,
+                         cs_real_t thickness_ratio,
+                         int n_fields,
+                         const cs_field_t *fields[],
+                         const int scale_exp[],
+                         struct recycle_inflow_t* rc)
+{
+    const cs_mesh_t *m = cs_glob_mesh;
+    const cs_mesh_quantities_t *mq = cs_glob_mesh_quantities;
+    const cs_real_3_t *b_face_cog = (const cs_real_3_t *)mq->b_face_cog;
+    const cs_real_3_t *cell_cen = (const cs_real_3_t *)mq->cell_cen;
+    const int n_ranks = cs_glob_n_ranks;
+
+    cs_real_t a[3], b[3];
+    cs_real_t len = sqrt(shift[0]*shift[0] + shift[1]*shift[1] + shift[2]*shift[2]);
+
+    memset(rc, 0, sizeof(struct recycle_inflow_t));
+    if (len <= 0. || n_fields > RECYCLE_INFLOW_MAX_FIELDS)
+        return EXIT_FAILURE;
+
+    for (int i = 0; i < 3; i++)
+        rc->dir[i] = shift[i]/len;
+    _plane_axes(rc->dir, a, b);
+
+    /* Fields and value layout */
+    rc->n_fields = n_fields;
+    for (int f_id = 0; f_id < n_fields; f_id++) {
+        rc->fields[f_id] = fields[f_id];
+        rc->n_vals += fields[f_id]->dim;
+    }
+    BFT_MALLOC(rc->scale_exp, rc->n_vals, int);
+    for (int f_id = 0, k = 0; f_id < n_fields; f_id++)
+        for (int j = 0; j < fields[f_id]->dim; j++)
+            rc->scale_exp[k++] = CS_MIN(CS_MAX(scale_exp[f_id], 0), 3);
+
+    /* Inlet faces and their donor points */
+    BFT_MALLOC(rc->face_ids, m->n_b_faces, cs_lnum_t);
+    cs_selector_get_b_face_list(inlet_criteria, &(rc->n_faces), rc->face_ids);
+    BFT_REALLOC(rc->face_ids, rc->n_faces, cs_lnum_t);
+
+    cs_real_t *q;
+    cs_real_t sums[3] = {0., 0., 0.};   /* plane position, count, area */
+    BFT_MALLOC(q, 3*rc->n_faces, cs_real_t);
+    for (cs_lnum_t i = 0; i < rc->n_faces; i++) {
+        cs_lnum_t face_id = rc->face_ids[i];
+        for (int j = 0; j < 3; j++)
+            q[3*i+j] = b_face_cog[face_id][j] + shift[j];
+        q[3*i+1] = y_wall + (b_face_cog[face_id][1] - y_wall)*thickness_ratio
+                 + shift[1];
+        sums[0] += q[3*i]*rc->dir[0] + q[3*i+1]*rc->dir[1] + q[3*i+2]*rc->dir[2];
+        sums[1] += 1.;
+        sums[2] += mq->b_face_surf[face_id];
+    }
+#if defined(HAVE_MPI)
+    if (n_ranks > 1)
+        MPI_Allreduce(MPI_IN_PLACE, sums, 3, CS_MPI_REAL, MPI_SUM, cs_glob_mpi_comm);
+#endif
+    if (sums[1] < 1.) {
+        BFT_FREE(q);
+        recycle_inflow_free(rc);
+        return EXIT_FAILURE;
+    }
+    const cs_real_t s_plane = sums[0]/sums[1];
+    rc->inlet_area = sums[2];
+
+    /* Local candidate donor cells: layer of cells around the plane */
+    cs_lnum_t n_loc = 0;
+    cs_real_t *loc_xyz;
+    cs_lnum_t *loc_ids;
+    BFT_MALLOC(loc_xyz, 3*m->n_cells, cs_real_t);
+    BFT_MALLOC(loc_ids, m->n_cells, cs_lnum_t);
+    for (cs_lnum_t c = 0; c < m->n_cells; c++) {
+        cs_real_t s = cell_cen[c][0]*rc->dir[0] + cell_cen[c][1]*rc->dir[1]
+                    + cell_cen[c][2]*rc->dir[2];
+        if (fabs(s - s_plane) <= slab) {
+            for (int j = 0; j < 3; j++)
+                loc_xyz[3*n_loc+j] = cell_cen[c][j];
+            loc_ids[n_loc++] = c;
+        }
+    }
+
+    /* All candidates on all ranks (a plane of cells, done once) */
+    int *cand_count, *cand_shift;
+    cs_lnum_t n_cand = n_loc;
+    cs_real_t *cand_xyz = loc_xyz;
+    cs_lnum_t *cand_ids = loc_ids;
+    BFT_MALLOC(cand_count, n_ranks, int);
+    BFT_MALLOC(cand_shift, n_ranks + 1, int);
+    cand_count[0] = n_loc;
+    cand_shift[0] = 0;
+    cand_shift[1] = n_loc;
+
+#if defined(HAVE_MPI)
+    if (n_ranks > 1) {
+        int *cnt3, *shift3;
+        int _n_loc = n_loc;
+        MPI_Allgather(&_n_loc, 1, MPI_INT, cand_count, 1, MPI_INT, cs_glob_mpi_comm);
+        BFT_MALLOC(cnt3, n_ranks, int);
+        BFT_MALLOC(shift3, n_ranks, int);
+        for (int r = 0; r < n_ranks; r++) {
+            cand_shift[r+1] = cand_shift[r] + cand_count[r];
+            cnt3[r] = 3*cand_count[r];
+            shift3[r] = 3*cand_shift[r];
+        }
+        n_cand = cand_shift[n_ranks];
+        BFT_MALLOC(cand_xyz, 3*n_cand, cs_real_t);
+        BFT_MALLOC(cand_ids, n_cand, cs_lnum_t);
+        MPI_Allgatherv(loc_xyz, 3*n_loc, CS_MPI_REAL,
+                       cand_xyz, cnt3, shift3, CS_MPI_REAL, cs_glob_mpi_comm);
+        MPI_Allgatherv(loc_ids, n_loc, CS_MPI_LNUM,
+                       cand_ids, cand_count, cand_shift, CS_MPI_LNUM, cs_glob_mpi_comm);
+        BFT_FREE(cnt3);
+        BFT_FREE(shift3);
+        BFT_FREE(loc_xyz);
+        BFT_FREE(loc_ids);
+    }
+#endif
+
+    if (n_cand == 0) {
+        bft_printf("recycle_inflow: no cell within %g of the recycling plane\n",
+                   slab);
+        BFT_FREE(q);
+        BFT_FREE(cand_xyz);
+        BFT_FREE(cand_ids);
+        BFT_FREE(cand_count);
+        BFT_FREE(cand_shift);
+        recycle_inflow_free(rc);
+        return EXIT_FAILURE;
+    }
+
+    /* Donor of each inlet face */
+    struct _donor_grid_t grid;
+    cs_real_t *cand_uv;
+    cs_lnum_t *donor;
+    int *donor_rank;
+    BFT_MALLOC(cand_uv, 2*n_cand, cs_real_t);
+    for (cs_lnum_t i = 0; i < n_cand; i++) {
+        const cs_real_t *x = cand_xyz + 3*i;
+        cand_uv[2*i]   = x[0]*a[0] + x[1]*a[1] + x[2]*a[2];
+        cand_uv[2*i+1] = x[0]*b[0] + x[1]*b[1] + x[2]*b[2];
+    }
+    _donor_grid_build(n_cand, cand_uv, &grid);
+
+    BFT_MALLOC(donor, rc->n_faces, cs_lnum_t);
+    BFT_MALLOC(donor_rank, rc->n_faces, int);
+    for (cs_lnum_t i = 0; i < rc->n_faces; i++) {
+        const cs_real_t *x = q + 3*i;
+        cs_real_t quv[2] = {x[0]*a[0] + x[1]*a[1] + x[2]*a[2],
+                            x[0]*b[0] + x[1]*b[1] + x[2]*b[2]};
+        cs_lnum_t k = _donor_grid_closest(&grid, cand_xyz, quv, x);
+        int r = 0;
+        while (cand_shift[r+1] <= k)
+            r++;
+        donor_rank[i] = r;
+        donor[i] = cand_ids[k];
+    }
+
+    BFT_FREE(grid.start);
+    BFT_FREE(grid.items);
+    BFT_FREE(cand_uv);
+    BFT_FREE(cand_xyz);
+    BFT_FREE(cand_ids);
+    BFT_FREE(cand_count);
+    BFT_FREE(cand_shift);
+    BFT_FREE(q);
+
+    /* Fixed exchange pattern: faces grouped by donor rank */
+    int *req_count, *req_shift, *pos;
+    cs_lnum_t *req_ids;
+    BFT_MALLOC(req_count, n_ranks, int);
+    BFT_MALLOC(req_shift, n_ranks + 1, int);
+    BFT_MALLOC(pos, n_ranks, int);
+    BFT_MALLOC(req_ids, rc->n_faces, cs_lnum_t);
+    BFT_MALLOC(rc->face_slot, rc->n_faces, cs_lnum_t);
+
+    memset(req_count, 0, n_ranks*sizeof(int));
+    for (cs_lnum_t i = 0; i < rc->n_faces; i++)
+        req_count[donor_rank[i]] += 1;
+    req_shift[0] = 0;
+    for (int r = 0; r < n_ranks; r++) {
+        req_shift[r+1] = req_shift[r] + req_count[r];
+        pos[r] = req_shift[r];
+    }
+    for (cs_lnum_t i = 0; i < rc->n_faces; i++) {
+        int p = pos[donor_rank[i]]++;
+        req_ids[p] = donor[i];
+        rc->face_slot[i] = p;
+    }
+
+    BFT_MALLOC(rc->send_count, n_ranks, int);
+    BFT_MALLOC(rc->send_shift, n_ranks, int);
+    BFT_MALLOC(rc->recv_count, n_ranks, int);
+    BFT_MALLOC(rc->recv_shift, n_ranks, int);
+
+    if (n_ranks == 1) {
+        rc->n_send = rc->n_faces;
+        BFT_MALLOC(rc->send_cell_ids, rc->n_send, cs_lnum_t);
+        memcpy(rc->send_cell_ids, req_ids, rc->n_send*sizeof(cs_lnum_t));
+        rc->send_count[0] = rc->recv_count[0] = rc->n_faces*rc->n_vals;
+        rc->send_shift[0] = rc->recv_shift[0] = 0;
+    }
+#if defined(HAVE_MPI)
+    else {
+        int *snd_count, *snd_shift;
+        BFT_MALLOC(snd_count, n_ranks, int);
+        BFT_MALLOC(snd_shift, n_ranks + 1, int);
+        MPI_Alltoall(req_count, 1, MPI_INT, snd_count, 1, MPI_INT, cs_glob_mpi_comm);
+        snd_shift[0] = 0;
+        for (int r = 0; r < n_ranks; r++)
+            snd_shift[r+1] = snd_shift[r] + snd_count[r];
+        rc->n_send = snd_shift[n_ranks];
+        BFT_MALLOC(rc->send_cell_ids, rc->n_send, cs_lnum_t);
+        MPI_Alltoallv(req_ids, req_count, req_shift, CS_MPI_LNUM,
+                      rc->send_cell_ids, snd_count, snd_shift, CS_MPI_LNUM,
+                      cs_glob_mpi_comm);
+        for (int r = 0; r < n_ranks; r++) {
+            rc->send_count[r] = snd_count[r]*rc->n_vals;
+            rc->send_shift[r] = snd_shift[r]*rc->n_vals;
+            rc->recv_count[r] = req_count[r]*rc->n_vals;
+            rc->recv_shift[r] = req_shift[r]*rc->n_vals;
+        }
+        BFT_FREE(snd_count);
+        BFT_FREE(snd_shift);
+    }
+#endif
+
+    BFT_MALLOC(rc->send_buf, rc->n_send*rc->n_vals, cs_real_t);
+    BFT_MALLOC(rc->recv_buf, rc->n_faces*rc->n_vals, cs_real_t);
+
+    BFT_FREE(req_ids);
+    BFT_FREE(pos);
+    BFT_FREE(req_shift);
+    BFT_FREE(req_count);
+    BFT_FREE(donor_rank);
+    BFT_FREE(donor);
+
+    return EXIT_SUCCESS;
+}
+
+
+void recycle_inflow_gather(struct recycle_inflow_t* rc, cs_real_t *face_vals)
+{
+    const int n_vals = rc->n_vals;
+
+    /* Pack donor cell values */
+    for (cs_lnum_t i = 0; i < rc->n_send; i++) {
+        cs_lnum_t c = rc->send_cell_ids[i];
+        cs_real_t *v = rc->send_buf + i*n_vals;
+        for (int f_id = 0; f_id < rc->n_fields; f_id++) {
+            const int dim = rc->fields[f_id]->dim;
+            const cs_real_t *val = rc->fields[f_id]->val + c*dim;
+            for (int j = 0; j < dim; j++)
+                *v++ = val[j];
+        }
+    }
+
+    if (cs_glob_n_ranks == 1)
+        memcpy(rc->recv_buf, rc->send_buf, rc->n_send*n_vals*sizeof(cs_real_t));
+#if defined(HAVE_MPI)
+    else
+        MPI_Alltoallv(rc->send_buf, rc->send_count, rc->send_shift, CS_MPI_REAL,
+                      rc->recv_buf, rc->recv_count, rc->recv_shift, CS_MPI_REAL,
+                      cs_glob_mpi_comm);
+#endif
+
+    /* Unpack in inlet face order */
+    for (cs_lnum_t i = 0; i < rc->n_faces; i++) {
+        const cs_real_t *v = rc->recv_buf + rc->face_slot[i]*n_vals;
+        for (int j = 0; j < n_vals; j++)
+            face_vals[i*n_vals + j] = v[j];
+    }
+}
+
+
+cs_real_t recycle_inflow_rescale(const struct recycle_inflow_t* rc,
+                                 cs_real_t *face_vals)
+{
+    const cs_real_t *b_face_surf = cs_glob_mesh_quantities->b_face_surf;
+    const int n_vals = rc->n_vals;
+    cs_real_t flux = 0.;
+
+    if (rc->target_bulk <= 0. || rc->inlet_area <= 0.)
+        return 1.;
+
+    /* Velocity is the first recycled field */
+    for (cs_lnum_t i = 0; i < rc->n_faces; i++) {
+        const cs_real_t *u = face_vals + i*n_vals;
+        flux += b_face_surf[rc->face_ids[i]]
+              * (u[0]*rc->dir[0] + u[1]*rc->dir[1] + u[2]*rc->dir[2]);
+    }
+#if defined(HAVE_MPI)
+    if (cs_glob_n_ranks > 1)
+        MPI_Allreduce(MPI_IN_PLACE, &flux, 1, CS_MPI_REAL, MPI_SUM, cs_glob_mpi_comm);
+#endif
+
+    cs_real_t bulk = flux/rc->inlet_area;
+    if (fabs(bulk) < 1.e-12)
+        return 1.;
+
+    cs_real_t ratio = rc->target_bulk/bulk;
+    cs_real_t f[4] = {1., ratio, ratio*ratio, ratio*ratio*fabs(ratio)};
+    for (cs_lnum_t i = 0; i < rc->n_faces; i++)
+        for (int j = 0; j < n_vals; j++)
+            face_vals[i*n_vals + j] *= f[rc->scale_exp[j]];
+
+    return ratio;
+}
+
+
+void recycle_inflow_free(struct recycle_inflow_t* rc)
+{
+    BFT_FREE(rc->face_ids);
+    BFT_FREE(rc->face_slot);
+    BFT_FREE(rc->scale_exp);
+    BFT_FREE(rc->send_cell_ids);
+    BFT_FREE(rc->send_count);
+    BFT_FREE(rc->send_shift);
+    BFT_FREE(rc->recv_count);
+    BFT_FREE(rc->recv_shift);
+    BFT_FREE(rc->send_buf);
+    BFT_FREE(rc->recv_buf);
+    rc->n_faces = 0;
+    rc->n_send = 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
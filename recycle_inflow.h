@@ -0,0 +1,88 @@
+#ifndef RECYCLE_INFLOW_H
+#define RECYCLE_INFLOW_H
+
+#include "cs_defs.h"
+#include "cs_field.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RECYCLE_INFLOW_MAX_FIELDS 4
+
+
+/**
+* Recycling of the solution from a downstream plane back to the inlet.
+*
+* The inlet face -> donor cell map and the MPI exchange pattern are built
+* once by recycle_inflow_setup(); each time step then only needs
+* recycle_inflow_gather() (and optionally recycle_inflow_rescale()).
+*/
+struct recycle_inflow_t {
+    cs_lnum_t n_faces;          /* inlet faces on this rank */
+    cs_lnum_t *face_ids;        /* inlet boundary face ids */
+    cs_lnum_t *face_slot;       /* position of each face value in the receive buffer */
+
+    int n_fields;
+    const cs_field_t *fields[RECYCLE_INFLOW_MAX_FIELDS];
+    int n_vals;                 /* values per face (sum of field dimensions) */
+    int *scale_exp;             /* power of the velocity ratio applied to each value */
+
+    cs_real_t dir[3];           /* unit streamwise direction (inlet -> plane) */
+    cs_real_t inlet_area;       /* global inlet surface */
+    cs_real_t target_bulk;      /* target bulk velocity, <= 0 for no rescaling */
+
+    /* Fixed exchange pattern */
+    cs_lnum_t n_send;           /* donor cells sent by this rank each step */
+    cs_lnum_t *send_cell_ids;
+    int *send_count, *send_shift;     /* per rank, in values */
+    int *recv_count, *recv_shift;     /* per rank, in values */
+    cs_real_t *send_buf;
+    cs_real_t *recv_buf;
+};
+
+
+/**
+* Build the recycling map.
+*
+* inlet_criteria: selection criteria of the inlet faces
+* shift:          translation from the inlet to the recycling plane
+* slab:           half thickness of the layer of cells searched around the plane
+* y_wall, thickness_ratio: the wall-normal (y) distance of the donor point
+*                 is stretched by thickness_ratio = delta_plane/delta_inlet
+*                 (1 keeps the geometric mapping)
+* n_fields, fields: fields to recycle (velocity first)
+* scale_exp:      per field power of the velocity ratio used by the rescaling
+*                 (1 for velocity, 2 for k or Rij, 3 for epsilon)
+*/
+int recycle_inflow_setup(const char *inlet_criteria,
+                         const cs_real_t shift[3],
+                         cs_real_t slab,
+                         cs_real_t y_wall,
+                         cs_real_t thickness_ratio,
+                         int n_fields,
+                         const cs_field_t *fields[],
+                         const int scale_exp[],
+                         struct recycle_inflow_t* rc);
+
+/**
+* Gather the donor values of all recycled fields for the inlet faces.
+* face_vals is interlaced: n_faces x n_vals.
+*/
+void recycle_inflow_gather(struct recycle_inflow_t* rc, cs_real_t *face_vals);
+
+/**
+* Rescale gathered values so that the inlet bulk velocity equals
+* rc->target_bulk. Returns the applied velocity ratio.
+*/
+cs_real_t recycle_inflow_rescale(const struct recycle_inflow_t* rc,
+                                 cs_real_t *face_vals);
+
+void recycle_inflow_free(struct recycle_inflow_t* rc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RECYCLE_INFLOW_H
@@ -0,0 +1,112 @@
+/*
+* Stand-alone conversion of an ESRI ASCII grid of seabed roughness z0 (m)
+* into the tiled raster read by roughness_map_open().
+*
+*   cc -O2 -o roughness_convert roughness_convert.c roughness_map.c -lm
+*   ./roughness_convert seabed_z0.asc seabed_z0.map [tile=64x64] [nodata=1e-4]
+*
+* Grid eastings map to x and northings to z. NODATA cells take the
+* nodata value (Z0SEABED by default). tile_nx*tile_nz must be a multiple
+* of 1024.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "roughness_map.h"
+
+int main(int argc, char *argv[])
+{
+    uint32_t tile_nx = 64, tile_nz = 64;
+    double fill = Z0SEABED;
+
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s in.asc out.map [tile=NXxNZ] [nodata=z0]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    for (int i = 3; i < argc; i++) {
+        if (strncmp(argv[i], "tile=", 5) == 0
+            && sscanf(argv[i] + 5, "%ux%u", &tile_nx, &tile_nz) == 2)
+            continue;
+        if (strncmp(argv[i], "nodata=", 7) == 0) {
+            fill = atof(argv[i] + 7);
+            continue;
+        }
+        fprintf(stderr, "bad option \"%s\"\n", argv[i]);
+        return EXIT_FAILURE;
+    }
+
+    FILE* stream = fopen(argv[1], "r");
+    if (stream == NULL) {
+        fprintf(stderr, "error of reading file %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    /* Header: ncols, nrows, xll/yll (corner or center), cellsize, [NODATA_value] */
+    long n_cols = 0, n_rows = 0;
+    double xll = 0., yll = 0., cell = 0., nodata = -9999.;
+    int center = 0, has_nodata = 0;
+    for (;;) {
+        char key[32];
+        double v;
+        long pos = ftell(stream);
+        if (fscanf(stream, "%31s %lf", key, &v) != 2) {
+            fseek(stream, pos, SEEK_SET);
+            break;
+        }
+        if (strcasecmp(key, "ncols") == 0)              n_cols = (long)v;
+        else if (strcasecmp(key, "nrows") == 0)         n_rows = (long)v;
+        else if (strcasecmp(key, "xllcorner") == 0)     xll = v;
+        else if (strcasecmp(key, "yllcorner") == 0)     yll = v;
+        else if (strcasecmp(key, "xllcenter") == 0)     { xll = v; center = 1; }
+        else if (strcasecmp(key, "yllcenter") == 0)     yll = v;
+        else if (strcasecmp(key, "cellsize") == 0)      cell = v;
+        else if (strcasecmp(key, "nodata_value") == 0)  { nodata = v; has_nodata = 1; }
+        else {
+            fseek(stream, pos, SEEK_SET);   /* first data value */
+            break;
+        }
+    }
+    if (n_cols <= 0 || n_rows <= 0 || !(cell > 0.)) {
+        fprintf(stderr, "%s: missing ncols, nrows or cellsize\n", argv[1]);
+        fclose(stream);
+        return EXIT_FAILURE;
+    }
+
+    /* Rows are stored north to south, the raster from z0 upwards */
+    float *values = (float *) malloc((size_t)n_cols*n_rows*sizeof(float));
+    size_t n_fill = 0;
+    for (long r = 0; r < n_rows; r++) {
+        float *row = values + (size_t)(n_rows - 1 - r)*n_cols;
+        for (long i = 0; i < n_cols; i++) {
+            double v;
+            if (fscanf(stream, "%lf", &v) != 1) {
+                fprintf(stderr, "%s: %ld values, %ld expected\n",
+                        argv[1], r*n_cols + i, n_cols*n_rows);
+                free(values);
+                fclose(stream);
+                return EXIT_FAILURE;
+            }
+            if ((has_nodata && v == nodata) || !(v > 0.)) {
+                v = fill;
+                n_fill++;
+            }
+            row[i] = (float)v;
+        }
+    }
+    fclose(stream);
+
+    const double x0 = center ? xll : xll + 0.5*cell;
+    const double z0 = center ? yll : yll + 0.5*cell;
+    int status = roughness_map_write(argv[2], (uint32_t)n_cols, (uint32_t)n_rows,
+                                     x0, z0, cell, cell, tile_nx, tile_nz, values);
+    free(values);
+    if (status != EXIT_SUCCESS) {
+        fprintf(stderr, "error of writing file %s (tile %ux%u)\n", argv[2], tile_nx, tile_nz);
+        return EXIT_FAILURE;
+    }
+    printf("%ld x %ld samples (%lu filled with %g) written to %s\n",
+           n_cols, n_rows, (unsigned long)n_fill, fill, argv[2]);
+    return EXIT_SUCCESS;
+}
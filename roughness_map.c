@@ -0,0 +1,257 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "roughness_map.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+* File layout (native byte order):
+*   char     magic[8]               "CSZ0MAP"
+*   uint32   nx, nz, tile_nx, tile_nz
+*   double   x0, z0, dx, dz
+*   padding up to ROUGHNESS_MAP_HEADER_SIZE
+*   tiles, row of tiles by row of tiles along z, each tile being
+*   tile_nz x tile_nx floats (edge tiles are padded to the full size)
+*/
+
+#define ROUGHNESS_MAP_HEADER_SIZE 4096
+
+static const char _magic[8] = "CSZ0MAP";
+
+/* One raster sample needed by one corner of one point */
+struct _sample_t {
+    size_t tile;
+    size_t local;               /* position inside the tile */
+    size_t dest;                /* 4*point + corner */
+};
+
+static int
+_cmp_sample(const void *a, const void *b)
+{
+    const struct _sample_t *sa = (const struct _sample_t *)a;
+    const struct _sample_t *sb = (const struct _sample_t *)b;
+    if (sa->tile != sb->tile)
+        return (sa->tile < sb->tile) ? -1 : 1;
+    return (sa->local < sb->local) ? -1 : (sa->local > sb->local);
+}
+
+/* Lower interpolation index and weight along one direction */
+static size_t
+_locate(double x, double x0, double dx, uint32_t n, double *t)
+{
+    double f = (x - x0)/dx;
+    size_t i;
+
+    if (n < 2 || f <= 0.) {
+        *t = 0.;
+        return 0;
+    }
+    if (f >= (double)(n - 1)) {
+        *t = 1.;
+        return n - 2;
+    }
+    i = (size_t)f;
+    *t = f - (double)i;
+    return i;
+}
+
+
+int roughness_map_open(const char *fName, struct roughness_map_t* map)
+{
+    char magic[8];
+    uint32_t dims[4];
+    double geom[4];
+    struct stat sb;
+
+    memset(map, 0, sizeof(struct roughness_map_t));
+    map->fd = open(fName, O_RDONLY);
+    if (map->fd < 0)
+        return EXIT_FAILURE;
+
+    if (   read(map->fd, magic, 8) != 8
+        || memcmp(magic, _magic, 8) != 0
+        || read(map->fd, dims, sizeof(dims)) != (ssize_t)sizeof(dims)
+        || read(map->fd, geom, sizeof(geom)) != (ssize_t)sizeof(geom)
+        || dims[0] == 0 || dims[1] == 0 || dims[2] == 0 || dims[3] == 0) {
+        close(map->fd);
+        map->fd = -1;
+        return EXIT_FAILURE;
+    }
+
+    map->nx = dims[0];
+    map->nz = dims[1];
+    map->tile_nx = dims[2];
+    map->tile_nz = dims[3];
+    map->n_tiles_x = (map->nx + map->tile_nx - 1)/map->tile_nx;
+    map->n_tiles_z = (map->nz + map->tile_nz - 1)/map->tile_nz;
+    map->x0 = geom[0];
+    map->z0 = geom[1];
+    map->dx = geom[2];
+    map->dz = geom[3];
+    map->data_offset = ROUGHNESS_MAP_HEADER_SIZE;
+
+    /* Reject a bad spacing, and a truncated file before any tile is mapped
+       (reading past its end would raise SIGBUS) */
+    const size_t data_size =   (size_t)map->n_tiles_x*map->n_tiles_z
+                             * map->tile_nx*map->tile_nz*sizeof(float);
+    if (   !(map->dx > 0.) || !(map->dz > 0.)
+        || !isfinite(map->x0) || !isfinite(map->z0)
+        || fstat(map->fd, &sb) != 0
+        || (size_t)sb.st_size < map->data_offset + data_size) {
+        close(map->fd);
+        map->fd = -1;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+int roughness_map_sample(const struct roughness_map_t* map,
+                         size_t n,
+                         const double *xyz,
+                         double *z0)
+{
+    const size_t tile_size = (size_t)map->tile_nx*map->tile_nz;
+    const size_t tile_bytes = tile_size*sizeof(float);
+    const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    struct _sample_t *s;
+    double *tw, *corner;
+    int status = EXIT_SUCCESS;
+
+    if (n == 0)
+        return EXIT_SUCCESS;
+    if (map->fd < 0)
+        return EXIT_FAILURE;
+
+    s = (struct _sample_t *) malloc(4*n*sizeof(struct _sample_t));
+    tw = (double *) malloc(2*n*sizeof(double));
+    corner = (double *) malloc(4*n*sizeof(double));
+
+    /* Raster samples of the 4 corners of each point */
+    for (size_t p = 0; p < n; p++) {
+        size_t i0 = _locate(xyz[3*p], map->x0, map->dx, map->nx, tw + 2*p);
+        size_t k0 = _locate(xyz[3*p+2], map->z0, map->dz, map->nz, tw + 2*p + 1);
+        for (int c = 0; c < 4; c++) {
+            size_t i = i0 + ((map->nx > 1) ? (size_t)(c & 1) : 0);
+            size_t k = k0 + ((map->nz > 1) ? (size_t)(c >> 1) : 0);
+            struct _sample_t *sc = s + 4*p + c;
+            sc->tile = (k/map->tile_nz)*map->n_tiles_x + i/map->tile_nx;
+            sc->local = (k%map->tile_nz)*map->tile_nx + i%map->tile_nx;
+            sc->dest = 4*p + c;
+        }
+    }
+
+    /* Visit the needed tiles only, one mapping at a time */
+    qsort(s, 4*n, sizeof(struct _sample_t), _cmp_sample);
+
+    for (size_t b = 0; b < 4*n && status == EXIT_SUCCESS; ) {
+        size_t e = b;
+        size_t offset = map->data_offset + s[b].tile*tile_bytes;
+        size_t shift = offset % page;
+        size_t len = tile_bytes + shift;
+
+        while (e < 4*n && s[e].tile == s[b].tile)
+            e++;
+
+        void *ptr = mmap(NULL, len, PROT_READ, MAP_SHARED, map->fd,
+                         (off_t)(offset - shift));
+        if (ptr == MAP_FAILED) {
+            status = EXIT_FAILURE;
+            break;
+        }
+        const float *tile = (const float *)((const char *)ptr + shift);
+        for (size_t j = b; j < e; j++)
+            corner[s[j].dest] = tile[s[j].local];
+        munmap(ptr, len);
+
+        b = e;
+    }
+
+    /* Bilinear interpolation */
+    if (status == EXIT_SUCCESS) {
+        for (size_t p = 0; p < n; p++) {
+            const double tx = tw[2*p], tz = tw[2*p+1];
+            const double *v = corner + 4*p;
+            z0[p] =   (1.-tz)*((1.-tx)*v[0] + tx*v[1])
+                    +     tz *((1.-tx)*v[2] + tx*v[3]);
+        }
+    }
+
+    free(corner);
+    free(tw);
+    free(s);
+    return status;
+}
+
+
+void roughness_map_close(struct roughness_map_t* map)
+{
+    if (map->fd >= 0)
+        close(map->fd);
+    map->fd = -1;
+}
+
+
+int roughness_map_write(const char *fName,
+                        uint32_t nx, uint32_t nz,
+                        double x0, double z0, double dx, double dz,
+                        uint32_t tile_nx, uint32_t tile_nz,
+                        const float *values)
+{
+    uint32_t dims[4] = {nx, nz, tile_nx, tile_nz};
+    double geom[4] = {x0, z0, dx, dz};
+    char header[ROUGHNESS_MAP_HEADER_SIZE];
+    const size_t tile_size = (size_t)tile_nx*tile_nz;
+
+    if (tile_nx == 0 || tile_nz == 0 || tile_size % 1024 != 0)
+        return EXIT_FAILURE;
+
+    FILE* stream = fopen(fName, "wb");
+    if (stream == NULL)
+        return EXIT_FAILURE;
+
+    memset(header, 0, sizeof(header));
+    memcpy(header, _magic, 8);
+    memcpy(header + 8, dims, sizeof(dims));
+    memcpy(header + 8 + sizeof(dims), geom, sizeof(geom));
+    fwrite(header, 1, sizeof(header), stream);
+
+    float *tile = (float *) malloc(tile_size*sizeof(float));
+    const uint32_t n_tiles_x = (nx + tile_nx - 1)/tile_nx;
+    const uint32_t n_tiles_z = (nz + tile_nz - 1)/tile_nz;
+
+    for (uint32_t tk = 0; tk < n_tiles_z; tk++) {
+        for (uint32_t ti = 0; ti < n_tiles_x; ti++) {
+            for (uint32_t k = 0; k < tile_nz; k++) {
+                for (uint32_t i = 0; i < tile_nx; i++) {
+                    /* pad edge tiles with the last row/column */
+                    size_t gi = (size_t)ti*tile_nx + i;
+                    size_t gk = (size_t)tk*tile_nz + k;
+                    if (gi >= nx) gi = nx - 1;
+                    if (gk >= nz) gk = nz - 1;
+                    tile[(size_t)k*tile_nx + i] = values[gk*nx + gi];
+                }
+            }
+            fwrite(tile, sizeof(float), tile_size, stream);
+        }
+    }
+
+    free(tile);
+    return (fclose(stream) == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#ifdef __cplusplus
+}
+#endif
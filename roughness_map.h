@@ -0,0 +1,63 @@
+#ifndef ROUGHNESS_MAP_H
+#define ROUGHNESS_MAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Uniform seabed roughness, used where no raster is given */
+#define Z0SEABED 0.0001
+
+
+/**
+* Seabed roughness raster z0(x,z) stored as fixed-size tiles of floats.
+* Only the tiles touched by the sampled points are mapped, one at a time,
+* so the raster may be larger than the memory of a rank.
+*/
+struct roughness_map_t {
+    uint32_t nx, nz;            /* raster size (samples along x and z) */
+    uint32_t tile_nx, tile_nz;  /* tile size */
+    uint32_t n_tiles_x, n_tiles_z;
+    double x0, z0;              /* coordinates of sample (0,0) */
+    double dx, dz;              /* sample spacing */
+    size_t data_offset;         /* file offset of tile (0,0) */
+    int fd;
+};
+
+
+/**
+* Open a raster file and read its header.
+*/
+int roughness_map_open(const char *fName, struct roughness_map_t* map);
+
+/**
+* Bilinear interpolation of z0 at n points (x = xyz[3*i], z = xyz[3*i+2]).
+* Points outside the raster take the value of the closest edge.
+*/
+int roughness_map_sample(const struct roughness_map_t* map,
+                         size_t n,
+                         const double *xyz,
+                         double *z0);
+
+void roughness_map_close(struct roughness_map_t* map);
+
+/**
+* Write a raster from a full array values[k*nx + i] (for pre-processing,
+* see roughness_convert.c for ESRI ASCII grids).
+* tile_nx*tile_nz must be a multiple of 1024 so that tiles are page aligned.
+*/
+int roughness_map_write(const char *fName,
+                        uint32_t nx, uint32_t nz,
+                        double x0, double z0, double dx, double dz,
+                        uint32_t tile_nx, uint32_t tile_nz,
+                        const float *values);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ROUGHNESS_MAP_H
@@ -0,0 +1,451 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "cs_defs.h"
+
+#include "bft_mem.h"
+#include "bft_error.h"
+#include "bft_printf.h"
+
+#include "cs_field.h"
+#include "cs_field_pointer.h"
+#include "cs_mesh.h"
+#include "cs_mesh_quantities.h"
+#include "cs_selector.h"
+#include "cs_time_step.h"
+
+#include "surface_pod.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SURFACE_POD_JACOBI_SWEEPS 60
+#define SURFACE_POD_RANK_TOL 1.e-10     /* new direction dropped below tol x |x| */
+
+#define SURFACE_POD_K (SURFACE_POD_MAX_MODES + 1)
+
+
+static void
+_sum(cs_real_t *v, int n)
+{
+#if defined(HAVE_MPI)
+    if (cs_glob_n_ranks > 1)
+        MPI_Allreduce(MPI_IN_PLACE, v, n, CS_MPI_REAL, MPI_SUM, cs_glob_mpi_comm);
+#endif
+}
+
+/*
+* One-sided Jacobi SVD of the m x m matrix a (row-major, overwritten):
+* a v = u diag(s), singular values sorted in decreasing order, u in a.
+* Done identically on all ranks, so the modes stay consistent.
+*/
+static void
+_jacobi_svd(int m, cs_real_t a[], cs_real_t v[], cs_real_t s[])
+{
+    for (int i = 0; i < m*m; i++)
+        v[i] = 0.;
+    for (int i = 0; i < m; i++)
+        v[i*m + i] = 1.;
+
+    for (int sweep = 0; sweep < SURFACE_POD_JACOBI_SWEEPS; sweep++) {
+        int rotated = 0;
+        for (int i = 0; i < m - 1; i++) {
+            for (int j = i + 1; j < m; j++) {
+                cs_real_t alpha = 0., beta = 0., gamma = 0.;
+                for (int k = 0; k < m; k++) {
+                    alpha += a[k*m + i]*a[k*m + i];
+                    beta  += a[k*m + j]*a[k*m + j];
+                    gamma += a[k*m + i]*a[k*m + j];
+                }
+                if (fabs(gamma) <= 1.e-15*sqrt(alpha*beta) || gamma == 0.)
+                    continue;
+                rotated = 1;
+                const cs_real_t zeta = (beta - alpha)/(2.*gamma);
+                const cs_real_t t = ((zeta >= 0.) ? 1. : -1.)/(fabs(zeta) + sqrt(1. + zeta*zeta));
+                const cs_real_t c = 1./sqrt(1. + t*t), sn = c*t;
+                for (int k = 0; k < m; k++) {
+                    const cs_real_t ai = a[k*m + i], aj = a[k*m + j];
+                    a[k*m + i] = c*ai - sn*aj;
+                    a[k*m + j] = sn*ai + c*aj;
+                    const cs_real_t vi = v[k*m + i], vj = v[k*m + j];
+                    v[k*m + i] = c*vi - sn*vj;
+                    v[k*m + j] = sn*vi + c*vj;
+                }
+            }
+        }
+        if (!rotated)
+            break;
+    }
+
+    for (int j = 0; j < m; j++) {
+        cs_real_t n2 = 0.;
+        for (int k = 0; k < m; k++)
+            n2 += a[k*m + j]*a[k*m + j];
+        s[j] = sqrt(n2);
+        if (s[j] > 0.)
+            for (int k = 0; k < m; k++)
+                a[k*m + j] /= s[j];
+    }
+
+    /* Selection sort of the columns, m is small */
+    for (int j = 0; j < m - 1; j++) {
+        int j_max = j;
+        for (int l = j + 1; l < m; l++)
+            if (s[l] > s[j_max])
+                j_max = l;
+        if (j_max == j)
+            continue;
+        cs_real_t tmp = s[j]; s[j] = s[j_max]; s[j_max] = tmp;
+        for (int k = 0; k < m; k++) {
+            tmp = a[k*m + j]; a[k*m + j] = a[k*m + j_max]; a[k*m + j_max] = tmp;
+            tmp = v[k*m + j]; v[k*m + j] = v[k*m + j_max]; v[k*m + j_max] = tmp;
+        }
+    }
+}
+
+/* Current stress on the selected faces, weighted by sqrt(surface) */
+static void
+_snapshot(const struct surface_pod_t* sp, cs_real_t x[])
+{
+    const cs_mesh_quantities_t *mq = cs_glob_mesh_quantities;
+    const cs_real_3_t *normal = (const cs_real_3_t *) mq->b_face_normal;
+    const cs_field_t *f_force = cs_field_by_name_try("boundary_forces");
+
+    if (sp->n_vals == 1) {
+        const cs_real_t *p = CS_F_(p)->val;
+        for (cs_lnum_t i = 0; i < sp->n_faces; i++)
+            x[i] = sp->w[i]*p[cs_glob_mesh->b_face_cells[sp->face_ids[i]]];
+        return;
+    }
+
+    const cs_real_3_t *force = (const cs_real_3_t *) f_force->val;
+    for (cs_lnum_t i = 0; i < sp->n_faces; i++) {
+        const cs_lnum_t face_id = sp->face_ids[i];
+        const cs_real_t surf = mq->b_face_surf[face_id];
+        cs_real_t n[3], tr[3], pn = 0.;
+        for (int j = 0; j < 3; j++) {
+            n[j] = normal[face_id][j]/surf;
+            tr[j] = force[face_id][j]/surf;
+            pn += tr[j]*n[j];
+        }
+        cs_real_t *xi = x + i*4;
+        xi[0] = sp->w[i]*pn;
+        for (int j = 0; j < 3; j++)
+            xi[1 + j] = sp->w[i]*(tr[j] - pn*n[j]);
+    }
+}
+
+/* Brand's rank-one update of the thin SVD with the snapshot x */
+static void
+_update(struct surface_pod_t* sp, const cs_real_t x[], cs_real_t t)
+{
+    const cs_lnum_t n_rows = sp->n_rows;
+    const int ld = sp->max_modes;
+    const int r = sp->n_modes;
+    const int m = r + 1;
+    cs_real_t p[SURFACE_POD_K], p2[SURFACE_POD_K];
+    cs_real_t k[SURFACE_POD_K*SURFACE_POD_K], vk[SURFACE_POD_K*SURFACE_POD_K];
+    cs_real_t sk[SURFACE_POD_K];
+    cs_real_t *e = sp->x;         /* x is projected out in place */
+
+    if (e != x)
+        memcpy(e, x, n_rows*sizeof(cs_real_t));
+
+    /* Projection on the current modes (and |x|^2), twice for orthogonality */
+    for (int j = 0; j <= r; j++)
+        p[j] = 0.;
+    for (cs_lnum_t i = 0; i < n_rows; i++) {
+        const cs_real_t *ui = sp->u + i*ld;
+        for (int j = 0; j < r; j++)
+            p[j] += ui[j]*e[i];
+        p[r] += e[i]*e[i];
+    }
+    _sum(p, r + 1);
+    const cs_real_t x_norm = sqrt(p[r]);
+
+    for (int pass = 0; pass < 2; pass++) {
+        const cs_real_t *c = (pass == 0) ? p : p2;
+        for (cs_lnum_t i = 0; i < n_rows; i++) {
+            const cs_real_t *ui = sp->u + i*ld;
+            for (int j = 0; j < r; j++)
+                e[i] -= ui[j]*c[j];
+        }
+        if (pass == 1)
+            break;
+        for (int j = 0; j < r; j++)
+            p2[j] = 0.;
+        for (cs_lnum_t i = 0; i < n_rows; i++) {
+            const cs_real_t *ui = sp->u + i*ld;
+            for (int j = 0; j < r; j++)
+                p2[j] += ui[j]*e[i];
+        }
+        _sum(p2, r);
+    }
+    for (int j = 0; j < r; j++)
+        p[j] += p2[j];
+
+    cs_real_t e_norm = 0.;
+    for (cs_lnum_t i = 0; i < n_rows; i++)
+        e_norm += e[i]*e[i];
+    _sum(&e_norm, 1);
+    e_norm = sqrt(e_norm);
+
+    const int new_dir = (e_norm > SURFACE_POD_RANK_TOL*x_norm);
+    if (new_dir)
+        for (cs_lnum_t i = 0; i < n_rows; i++)
+            e[i] /= e_norm;
+
+    /* K = [diag(s) p; 0 |e|] = U_k S_k V_k^T */
+    for (int i = 0; i < m*m; i++)
+        k[i] = 0.;
+    for (int j = 0; j < r; j++) {
+        k[j*m + j] = sp->s[j];
+        k[j*m + r] = p[j];
+    }
+    k[r*m + r] = new_dir ? e_norm : 0.;
+    _jacobi_svd(m, k, vk, sk);
+
+    int r_new = new_dir ? m : r;
+    if (r_new > sp->max_modes)
+        r_new = sp->max_modes;
+
+    /* Modes: [U e] U_k, truncated */
+    for (cs_lnum_t i = 0; i < n_rows; i++) {
+        const cs_real_t *ui = sp->u + i*ld;
+        cs_real_t *wi = sp->u_work + i*ld;
+        for (int j = 0; j < r_new; j++) {
+            cs_real_t v = (new_dir) ? e[i]*k[r*m + j] : 0.;
+            for (int l = 0; l < r; l++)
+                v += ui[l]*k[l*m + j];
+            wi[j] = v;
+        }
+    }
+    cs_real_t *tmp = sp->u;
+    sp->u = sp->u_work;
+    sp->u_work = tmp;
+    for (int j = 0; j < r_new; j++)
+        sp->s[j] = sk[j];
+
+    /* Right singular vectors: [V 0; 0 1] V_k, truncated (rank 0) */
+    if (cs_glob_rank_id <= 0) {
+        if (sp->n_snapshots >= sp->max_snapshots) {
+            sp->max_snapshots = (sp->max_snapshots > 0) ? 2*sp->max_snapshots : 256;
+            BFT_REALLOC(sp->v, sp->max_snapshots*ld, cs_real_t);
+            BFT_REALLOC(sp->t, sp->max_snapshots, cs_real_t);
+        }
+        cs_real_t row[SURFACE_POD_K];
+        for (int s_id = 0; s_id < sp->n_snapshots; s_id++) {
+            cs_real_t *vs = sp->v + s_id*ld;
+            for (int j = 0; j < r_new; j++) {
+                row[j] = 0.;
+                for (int l = 0; l < r; l++)
+                    row[j] += vs[l]*vk[l*m + j];
+            }
+            for (int j = 0; j < r_new; j++)
+                vs[j] = row[j];
+        }
+        cs_real_t *vs = sp->v + sp->n_snapshots*ld;
+        for (int j = 0; j < r_new; j++)
+            vs[j] = vk[r*m + j];
+        sp->t[sp->n_snapshots] = t;
+    }
+
+    sp->n_modes = r_new;
+    sp->n_snapshots++;
+}
+
+
+int surface_pod_setup(const char *criteria,
+                      int n_modes,
+                      struct surface_pod_t* sp)
+{
+    const cs_mesh_t *m = cs_glob_mesh;
+    const cs_real_t *b_face_surf = cs_glob_mesh_quantities->b_face_surf;
+
+    memset(sp, 0, sizeof(struct surface_pod_t));
+    if (n_modes < 1 || n_modes > SURFACE_POD_MAX_MODES)
+        return EXIT_FAILURE;
+
+    BFT_MALLOC(sp->face_ids, m->n_b_faces, cs_lnum_t);
+    cs_selector_get_b_face_list(criteria, &(sp->n_faces), sp->face_ids);
+    BFT_REALLOC(sp->face_ids, sp->n_faces, cs_lnum_t);
+
+    cs_gnum_t n_g_faces = sp->n_faces;
+#if defined(HAVE_MPI)
+    if (cs_glob_n_ranks > 1)
+        MPI_Allreduce(MPI_IN_PLACE, &n_g_faces, 1, CS_MPI_GNUM, MPI_SUM, cs_glob_mpi_comm);
+#endif
+    if (n_g_faces == 0) {
+        BFT_FREE(sp->face_ids);
+        return EXIT_FAILURE;
+    }
+
+    BFT_MALLOC(sp->w, sp->n_faces, cs_real_t);
+    for (cs_lnum_t i = 0; i < sp->n_faces; i++)
+        sp->w[i] = sqrt(b_face_surf[sp->face_ids[i]]);
+
+    sp->n_vals = (cs_field_by_name_try("boundary_forces") != NULL) ? 4 : 1;
+    sp->n_rows = sp->n_faces*sp->n_vals;
+    sp->max_modes = n_modes;
+
+    BFT_MALLOC(sp->u, sp->n_rows*n_modes, cs_real_t);
+    BFT_MALLOC(sp->u_work, sp->n_rows*n_modes, cs_real_t);
+    BFT_MALLOC(sp->x, sp->n_rows, cs_real_t);
+
+    bft_printf("Surface POD on \"%s\": %llu faces, %s, %d modes.\n",
+               criteria, (unsigned long long)n_g_faces,
+               (sp->n_vals == 4) ? "pressure and shear" : "pressure only",
+               n_modes);
+    return EXIT_SUCCESS;
+}
+
+
+void surface_pod_sample(struct surface_pod_t* sp, int interval)
+{
+    if (   sp->u == NULL || interval <= 0
+        || cs_glob_time_step->nt_cur % interval != 0)
+        return;
+
+    _snapshot(sp, sp->x);
+    _update(sp, sp->x, cs_glob_time_step->t_cur);
+}
+
+
+int surface_pod_write(const struct surface_pod_t* sp, const char *prefix)
+{
+    const cs_real_3_t *b_face_cog = (const cs_real_3_t *) cs_glob_mesh_quantities->b_face_cog;
+    const int r = sp->n_modes;
+    const int ld = sp->max_modes;
+    const int rec_size = 3 + sp->n_vals*r;     /* face center, then the modes */
+    char fName[256];
+    int ret = EXIT_SUCCESS;
+
+    if (sp->u == NULL || r == 0)
+        return EXIT_FAILURE;
+
+    /* Modes of the local faces, surface weight removed */
+    cs_real_t *rec = NULL;
+    BFT_MALLOC(rec, sp->n_faces*rec_size + 1, cs_real_t);
+    for (cs_lnum_t i = 0; i < sp->n_faces; i++) {
+        cs_real_t *ri = rec + i*rec_size;
+        for (int j = 0; j < 3; j++)
+            ri[j] = b_face_cog[sp->face_ids[i]][j];
+        for (int mode = 0; mode < r; mode++)
+            for (int c = 0; c < sp->n_vals; c++)
+                ri[3 + mode*sp->n_vals + c] = sp->u[(i*sp->n_vals + c)*ld + mode]/sp->w[i];
+    }
+
+    cs_real_t *all = rec;
+    cs_lnum_t n_all = sp->n_faces;
+#if defined(HAVE_MPI)
+    int *count = NULL, *shift = NULL;
+    if (cs_glob_n_ranks > 1) {
+        int n_loc = sp->n_faces*rec_size;
+        if (cs_glob_rank_id == 0) {
+            BFT_MALLOC(count, cs_glob_n_ranks, int);
+            BFT_MALLOC(shift, cs_glob_n_ranks, int);
+        }
+        MPI_Gather(&n_loc, 1, MPI_INT, count, 1, MPI_INT, 0, cs_glob_mpi_comm);
+        if (cs_glob_rank_id == 0) {
+            int n = 0;
+            for (int rank = 0; rank < cs_glob_n_ranks; rank++) {
+                shift[rank] = n;
+                n += count[rank];
+            }
+            n_all = n/rec_size;
+            BFT_MALLOC(all, n + 1, cs_real_t);
+        }
+        MPI_Gatherv(rec, n_loc, CS_MPI_REAL, all, count, shift, CS_MPI_REAL, 0,
+                    cs_glob_mpi_comm);
+        BFT_FREE(count);
+        BFT_FREE(shift);
+    }
+#endif
+
+    if (cs_glob_rank_id <= 0) {
+        const char *comp = (sp->n_vals == 4) ? " p tx ty tz" : " p";
+        FILE *f;
+
+        snprintf(fName, sizeof(fName), "%s_sv.dat", prefix);
+        f = fopen(fName, "w");
+        if (f != NULL) {
+            fprintf(f, "# %d snapshots, mode, singular value, energy fraction\n",
+                    sp->n_snapshots);
+            cs_real_t e_sum = 0.;
+            for (int mode = 0; mode < r; mode++)
+                e_sum += sp->s[mode]*sp->s[mode];
+            for (int mode = 0; mode < r; mode++)
+                fprintf(f, "%d %.8e %.6e\n", mode, sp->s[mode],
+                        (e_sum > 0.) ? sp->s[mode]*sp->s[mode]/e_sum : 0.);
+            fclose(f);
+        }
+        else
+            ret = EXIT_FAILURE;
+
+        snprintf(fName, sizeof(fName), "%s_modes.dat", prefix);
+        f = fopen(fName, "w");
+        if (f != NULL) {
+            fprintf(f, "# x y z, then for each of the %d modes:%s\n", r, comp);
+            for (cs_lnum_t i = 0; i < n_all; i++) {
+                const cs_real_t *ri = all + i*rec_size;
+                fprintf(f, "%.8e %.8e %.8e", ri[0], ri[1], ri[2]);
+                for (int j = 3; j < rec_size; j++)
+                    fprintf(f, " %.6e", ri[j]);
+                fprintf(f, "\n");
+            }
+            fclose(f);
+        }
+        else
+            ret = EXIT_FAILURE;
+
+        snprintf(fName, sizeof(fName), "%s_coef.dat", prefix);
+        f = fopen(fName, "w");
+        if (f != NULL) {
+            fprintf(f, "# t, then s_k v_k(t) for each of the %d modes\n", r);
+            for (int s_id = 0; s_id < sp->n_snapshots; s_id++) {
+                fprintf(f, "%.8e", sp->t[s_id]);
+                for (int mode = 0; mode < r; mode++)
+                    fprintf(f, " %.6e", sp->s[mode]*sp->v[s_id*ld + mode]);
+                fprintf(f, "\n");
+            }
+            fclose(f);
+        }
+        else
+            ret = EXIT_FAILURE;
+
+        if (ret == EXIT_SUCCESS)
+            bft_printf("Surface POD: %d modes of %d snapshots written to %s_*.dat.\n",
+                       r, sp->n_snapshots, prefix);
+    }
+
+    if (all != rec)
+        BFT_FREE(all);
+    BFT_FREE(rec);
+
+#if defined(HAVE_MPI)
+    if (cs_glob_n_ranks > 1)
+        MPI_Bcast(&ret, 1, MPI_INT, 0, cs_glob_mpi_comm);
+#endif
+    return ret;
+}
+
+
+void surface_pod_free(struct surface_pod_t* sp)
+{
+    BFT_FREE(sp->face_ids);
+    BFT_FREE(sp->w);
+    BFT_FREE(sp->u);
+    BFT_FREE(sp->u_work);
+    BFT_FREE(sp->x);
+    BFT_FREE(sp->v);
+    BFT_FREE(sp->t);
+    memset(sp, 0, sizeof(struct surface_pod_t));
+}
+
+#ifdef __cplusplus
+}
+#endif
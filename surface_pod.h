@@ -0,0 +1,80 @@
+#ifndef SURFACE_POD_H
+#define SURFACE_POD_H
+
+#include "cs_defs.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SURFACE_POD_MAX_MODES 64
+
+
+/**
+* Streaming POD (incremental SVD) of the stress on a set of boundary faces.
+*
+* Each snapshot holds, per face, the normal stress (pressure) and the
+* three components of the shear stress, from the "boundary_forces" field
+* (the pressure of the adjacent cell only if that field is not defined),
+* weighted by sqrt(face surface) so that the modes are orthonormal for
+* the surface integral.
+*
+* The rows of the snapshots are distributed as the faces are: each rank
+* keeps its rows of the r leading modes, so the memory is
+* O(n_faces x r), and an update needs three reductions of at most r
+* values followed by a (r+1) x (r+1) SVD done redundantly on all ranks.
+* Only rank 0 keeps the right singular vectors (n_snapshots x r) for
+* the time coefficients.
+*/
+struct surface_pod_t {
+    cs_lnum_t n_faces;          /* selected faces on this rank */
+    cs_lnum_t *face_ids;
+    cs_real_t *w;               /* sqrt(face surface) */
+    int n_vals;                 /* values per face: 4 (p, shear) or 1 (p) */
+    cs_lnum_t n_rows;           /* n_faces x n_vals */
+
+    int max_modes;
+    int n_modes;                /* current rank of the decomposition */
+    cs_real_t *u;               /* n_rows x max_modes, local rows of the modes */
+    cs_real_t s[SURFACE_POD_MAX_MODES];
+
+    int n_snapshots;
+    int max_snapshots;          /* allocated rows of v and t (rank 0) */
+    cs_real_t *v;               /* n_snapshots x max_modes (rank 0) */
+    cs_real_t *t;               /* time of each snapshot (rank 0) */
+
+    cs_real_t *x;               /* work arrays */
+    cs_real_t *u_work;
+};
+
+
+/**
+* Select the faces of criteria (e.g. "cable") and keep at most n_modes
+* modes (<= SURFACE_POD_MAX_MODES).
+*/
+int surface_pod_setup(const char *criteria,
+                      int n_modes,
+                      struct surface_pod_t* sp);
+
+/**
+* Add the current stress to the decomposition every "interval" time
+* steps (collective).
+*/
+void surface_pod_sample(struct surface_pod_t* sp, int interval);
+
+/**
+* Write <prefix>_sv.dat (singular values), <prefix>_modes.dat (face
+* center, then the modes of each face, surface weight removed) and
+* <prefix>_coef.dat (time, then the coefficient s_k v_k(t) of each mode).
+* Collective, rank 0 writes.
+*/
+int surface_pod_write(const struct surface_pod_t* sp, const char *prefix);
+
+void surface_pod_free(struct surface_pod_t* sp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SURFACE_POD_H
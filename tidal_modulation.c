@@ -0,0 +1,51 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "tidal_modulation.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static const double _pi = 3.14159265358979323846;
+
+
+void tidal_modulation_init(double mean, double t0, struct tidal_modulation_t* tm)
+{
+    memset(tm, 0, sizeof(struct tidal_modulation_t));
+    tm->mean = mean;
+    tm->t0 = t0;
+}
+
+
+int tidal_modulation_add(struct tidal_modulation_t* tm,
+                         const char *name,
+                         double amplitude,
+                         double period,
+                         double phase_deg)
+{
+    if (tm->n_constituents >= TIDAL_MAX_CONSTITUENTS || !(period > 0.))
+        return EXIT_FAILURE;
+
+    struct tidal_constituent_t *c = tm->c + tm->n_constituents++;
+    memset(c, 0, sizeof(struct tidal_constituent_t));
+    strncpy(c->name, name, sizeof(c->name) - 1);
+    c->amplitude = amplitude;
+    c->omega = 2.*_pi/period;
+    c->phase = phase_deg*_pi/180.;
+    return EXIT_SUCCESS;
+}
+
+
+double tidal_modulation_eval(const struct tidal_modulation_t* tm, double t)
+{
+    double s = tm->mean;
+    for (int i = 0; i < tm->n_constituents; i++)
+        s += tm->c[i].amplitude*cos(tm->c[i].omega*(t - tm->t0) - tm->c[i].phase);
+    return s;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,67 @@
+#ifndef TIDAL_MODULATION_H
+#define TIDAL_MODULATION_H
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TIDAL_MAX_CONSTITUENTS 16
+
+/* Periods of the main constituents (s) */
+#define TIDAL_PERIOD_M2 44714.16
+#define TIDAL_PERIOD_S2 43200.0
+#define TIDAL_PERIOD_N2 45570.05
+#define TIDAL_PERIOD_K2 43082.05
+#define TIDAL_PERIOD_K1 86164.09
+#define TIDAL_PERIOD_O1 92949.63
+#define TIDAL_PERIOD_M4 22357.08
+
+
+struct tidal_constituent_t {
+    char name[8];
+    double amplitude;       /* relative to the base profile */
+    double omega;           /* 2 pi/period (rad/s) */
+    double phase;           /* rad */
+};
+
+/**
+* Harmonic modulation s(t) = mean + sum a_i cos(omega_i (t - t0) - phase_i)
+* of a base profile. A negative s reverses the flow direction.
+*
+* The turbulence is scaled with max(|s|, turb_min) instead of s, so that
+* k and eps keep a background level at slack water rather than vanishing
+* (and eps/k, the inverse turbulence time scale, going to zero) while the
+* flow reverses. turb_min = 0 (default) scales the turbulence with s.
+*/
+struct tidal_modulation_t {
+    double mean;
+    double t0;              /* solver time of the reference phase */
+    double turb_min;        /* minimum |s| of the turbulence scales */
+    int n_constituents;
+    struct tidal_constituent_t c[TIDAL_MAX_CONSTITUENTS];
+};
+
+
+void tidal_modulation_init(double mean, double t0, struct tidal_modulation_t* tm);
+
+/**
+* Add a constituent, phase in degrees. Returns EXIT_FAILURE if the
+* table is full or the period is not positive.
+*/
+int tidal_modulation_add(struct tidal_modulation_t* tm,
+                         const char *name,
+                         double amplitude,
+                         double period,
+                         double phase_deg);
+
+/**
+* Velocity scale s(t).
+*/
+double tidal_modulation_eval(const struct tidal_modulation_t* tm, double t);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TIDAL_MODULATION_H
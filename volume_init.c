@@ -0,0 +1,437 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+#include "cs_defs.h"
+
+#include "bft_mem.h"
+#include "bft_error.h"
+#include "bft_printf.h"
+
+#include "cs_field.h"
+#include "cs_field_pointer.h"
+#include "cs_mesh.h"
+#include "cs_mesh_quantities.h"
+#include "cs_turbulence_model.h"
+
+#include "profile_columns.h"
+#include "volume_init.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VOLUME_INIT_MAX_VALS 10     /* u, v, w, Rij (6), eps */
+#define VOLUME_INIT_BATCH 4096      /* cells per OpenMP work item */
+
+/* Accepted column names of each quantity */
+struct _column_alias_t {
+    const char *names[5];
+};
+
+static const struct _column_alias_t _coord_names[3] = {
+    {{"x", "Points:0", "coordinates:0", NULL}},
+    {{"y", "Points:1", "coordinates:1", NULL}},
+    {{"z", "Points:2", "coordinates:2", NULL}}
+};
+
+static const struct _column_alias_t _keps_names[5] = {
+    {{"u", "U:0", "Velocity:0", NULL}},
+    {{"v", "U:1", "Velocity:1", NULL}},
+    {{"w", "U:2", "Velocity:2", NULL}},
+    {{"k", "TurbKinEner", NULL}},
+    {{"eps", "epsilon", "Dissip", NULL}}
+};
+
+static const struct _column_alias_t _rij_names[10] = {
+    {{"u", "U:0", "Velocity:0", NULL}},
+    {{"v", "U:1", "Velocity:1", NULL}},
+    {{"w", "U:2", "Velocity:2", NULL}},
+    {{"rxx", "Rij:0", "R11", NULL}},
+    {{"ryy", "Rij:1", "R22", NULL}},
+    {{"rzz", "Rij:2", "R33", NULL}},
+    {{"rxy", "Rij:3", "R12", NULL}},
+    {{"ryz", "Rij:4", "R23", NULL}},
+    {{"rxz", "Rij:5", "R13", NULL}},
+    {{"eps", "epsilon", "Dissip", NULL}}
+};
+
+/* Closest donor points found so far, sorted by distance */
+struct _knn_t {
+    int n;
+    size_t id[VOLUME_INIT_K];
+    double d2[VOLUME_INIT_K];
+};
+
+
+/* Case insensitive comparison, ignoring blanks and quotes around s */
+static int
+_name_eq(const char *s, size_t len, const char *name)
+{
+    while (len > 0 && (*s == ' ' || *s == '"' || *s == '\t')) {
+        s++; len--;
+    }
+    while (len > 0 && (s[len-1] == ' ' || s[len-1] == '"'
+                       || s[len-1] == '\n' || s[len-1] == '\r'))
+        len--;
+    if (strlen(name) != len)
+        return 0;
+    for (size_t i = 0; i < len; i++)
+        if (tolower((unsigned char)s[i]) != tolower((unsigned char)name[i]))
+            return 0;
+    return 1;
+}
+
+static int
+_find_slot(const char *s, size_t len, const struct _column_alias_t *q, int n_q)
+{
+    for (int i = 0; i < n_q; i++)
+        for (int a = 0; q[i].names[a] != NULL; a++)
+            if (_name_eq(s, len, q[i].names[a]))
+                return i;
+    return -1;
+}
+
+static int
+_in_box(const double box[6], const double x[3])
+{
+    return    x[0] >= box[0] && x[0] <= box[3] && x[1] >= box[1] && x[1] <= box[4]
+           && x[2] >= box[2] && x[2] <= box[5];
+}
+
+/* Partial sort of perm[lo, hi) so that perm[k] is the median along dim */
+static void
+_select(size_t *perm, const double *xyz, int dim,
+        ptrdiff_t lo, ptrdiff_t hi, ptrdiff_t k)
+{
+    hi--;
+    while (lo < hi) {
+        const double pivot = xyz[3*perm[lo + (hi - lo)/2] + dim];
+        ptrdiff_t i = lo, j = hi;
+        while (i <= j) {
+            while (xyz[3*perm[i] + dim] < pivot) i++;
+            while (xyz[3*perm[j] + dim] > pivot) j--;
+            if (i <= j) {
+                size_t t = perm[i];
+                perm[i++] = perm[j];
+                perm[j--] = t;
+            }
+        }
+        if (k <= j)
+            hi = j;
+        else if (k >= i)
+            lo = i;
+        else
+            return;
+    }
+}
+
+static int
+_build_tree(struct volume_init_t* vi, size_t *perm, size_t start, size_t end)
+{
+    const int node_id = vi->n_nodes++;
+    struct volume_init_node_t *node = vi->nodes + node_id;
+
+    node->start = start;
+    node->end = end;
+    node->dim = -1;
+    node->child[0] = node->child[1] = -1;
+    if (end - start <= VOLUME_INIT_LEAF)
+        return node_id;
+
+    /* Split the widest direction at the median */
+    double min[3] = {HUGE_VAL, HUGE_VAL, HUGE_VAL};
+    double max[3] = {-HUGE_VAL, -HUGE_VAL, -HUGE_VAL};
+    for (size_t i = start; i < end; i++)
+        for (int j = 0; j < 3; j++) {
+            const double x = vi->xyz[3*perm[i] + j];
+            min[j] = (x < min[j]) ? x : min[j];
+            max[j] = (x > max[j]) ? x : max[j];
+        }
+    int dim = 0;
+    for (int j = 1; j < 3; j++)
+        if (max[j] - min[j] > max[dim] - min[dim])
+            dim = j;
+
+    const size_t mid = start + (end - start)/2;
+    _select(perm, vi->xyz, dim, start, end, mid);
+
+    node->dim = dim;
+    node->split = vi->xyz[3*perm[mid] + dim];
+    int c0 = _build_tree(vi, perm, start, mid);
+    int c1 = _build_tree(vi, perm, mid, end);
+    vi->nodes[node_id].child[0] = c0;
+    vi->nodes[node_id].child[1] = c1;
+
+    return node_id;
+}
+
+static void
+_search(const struct volume_init_t* vi, int node_id, const double q[3],
+        struct _knn_t* r)
+{
+    const struct volume_init_node_t *node = vi->nodes + node_id;
+
+    if (node->dim < 0) {
+        for (size_t i = node->start; i < node->end; i++) {
+            const double *x = vi->xyz + 3*i;
+            const double d2 =   (x[0]-q[0])*(x[0]-q[0]) + (x[1]-q[1])*(x[1]-q[1])
+                              + (x[2]-q[2])*(x[2]-q[2]);
+            if (r->n == VOLUME_INIT_K && d2 >= r->d2[r->n-1])
+                continue;
+            int p = (r->n < VOLUME_INIT_K) ? r->n++ : r->n - 1;
+            while (p > 0 && r->d2[p-1] > d2) {
+                r->d2[p] = r->d2[p-1];
+                r->id[p] = r->id[p-1];
+                p--;
+            }
+            r->d2[p] = d2;
+            r->id[p] = i;
+        }
+        return;
+    }
+
+    const double d = q[node->dim] - node->split;
+    const int near = (d < 0.) ? 0 : 1;
+    _search(vi, node->child[near], q, r);
+    if (r->n < VOLUME_INIT_K || d*d < r->d2[r->n-1])
+        _search(vi, node->child[1-near], q, r);
+}
+
+
+int volume_init_load(const char *fName, double margin, struct volume_init_t* vi)
+{
+    const cs_lnum_t n_cells = cs_glob_mesh->n_cells;
+    const cs_real_t *cell_cen = cs_glob_mesh_quantities->cell_cen;
+    const int n_ranks = (cs_glob_n_ranks > 1) ? cs_glob_n_ranks : 1;
+    const int rank = (cs_glob_rank_id > 0) ? cs_glob_rank_id : 0;
+    const struct _column_alias_t *val_names = _keps_names;
+    int n_vals = 5;
+    double box[6] = {HUGE_VAL, HUGE_VAL, HUGE_VAL, -HUGE_VAL, -HUGE_VAL, -HUGE_VAL};
+    double *boxes;
+
+    memset(vi, 0, sizeof(struct volume_init_t));
+    if (cs_glob_turb_model->itytur == 3) {
+        val_names = _rij_names;
+        n_vals = 10;
+    }
+    vi->n_vals = n_vals;
+
+    /* Bounding box of each partition (min, max) */
+    for (cs_lnum_t i = 0; i < n_cells; i++)
+        for (int j = 0; j < 3; j++) {
+            box[j] = CS_MIN(box[j], cell_cen[3*i+j]);
+            box[3+j] = CS_MAX(box[3+j], cell_cen[3*i+j]);
+        }
+    for (int j = 0; j < 3; j++) {
+        box[j] -= margin;
+        box[3+j] += margin;
+    }
+    BFT_MALLOC(boxes, 6*n_ranks, double);
+    memcpy(boxes, box, 6*sizeof(double));
+#if defined(HAVE_MPI)
+    if (n_ranks > 1)
+        MPI_Allgather(box, 6, MPI_DOUBLE, boxes, 6, MPI_DOUBLE, cs_glob_mpi_comm);
+#endif
+
+    /* Each rank reads its share of the rows */
+    struct profile_columns_t cols;
+    int slot_col[3 + VOLUME_INIT_MAX_VALS];
+    int status[2] = {0, 0};         /* read error, missing columns */
+
+    if (profile_columns_read_csv_part(fName, rank, n_ranks, &cols) != EXIT_SUCCESS)
+        status[0] = 1;
+    else {
+        for (int j = 0; j < 3 + n_vals; j++)
+            slot_col[j] = -1;
+        for (int c = 0; c < cols.n_cols; c++) {
+            const char *name = cols.names[c];
+            int slot = _find_slot(name, strlen(name), _coord_names, 3);
+            if (slot < 0) {
+                slot = _find_slot(name, strlen(name), val_names, n_vals);
+                slot = (slot < 0) ? -1 : slot + 3;
+            }
+            if (slot > -1 && slot_col[slot] < 0)
+                slot_col[slot] = c;
+        }
+        for (int j = 0; j < 3 + n_vals; j++)
+            if (slot_col[j] < 0)
+                status[1] = 1;
+    }
+#if defined(HAVE_MPI)
+    if (n_ranks > 1)
+        MPI_Allreduce(MPI_IN_PLACE, status, 2, MPI_INT, MPI_MAX, cs_glob_mpi_comm);
+#endif
+    if (status[0] || status[1]) {
+        if (status[1] && !status[0])
+            bft_printf("Volume initialization: \"%s\" lacks some of the"
+                       " x, y, z, velocity and turbulence columns.\n", fName);
+        profile_columns_free(&cols);
+        BFT_FREE(boxes);
+        return EXIT_FAILURE;
+    }
+
+    /* Send each point to the ranks whose enlarged box holds it */
+    const int stride = 3 + n_vals;
+    int *count, *shift;
+    BFT_MALLOC(count, 4*n_ranks, int);
+    shift = count + n_ranks;
+    memset(count, 0, n_ranks*sizeof(int));
+
+    for (size_t i = 0; i < cols.n_rows; i++) {
+        const double x[3] = {cols.col[slot_col[0]][i], cols.col[slot_col[1]][i],
+                             cols.col[slot_col[2]][i]};
+        for (int r = 0; r < n_ranks; r++)
+            if (_in_box(boxes + 6*r, x))
+                count[r] += stride;
+    }
+    shift[0] = 0;
+    for (int r = 1; r < n_ranks; r++)
+        shift[r] = shift[r-1] + count[r-1];
+
+    double *send;
+    BFT_MALLOC(send, shift[n_ranks-1] + count[n_ranks-1] + 1, double);
+    {
+        int *pos = shift + n_ranks;
+        memcpy(pos, shift, n_ranks*sizeof(int));
+        for (size_t i = 0; i < cols.n_rows; i++) {
+            const double x[3] = {cols.col[slot_col[0]][i], cols.col[slot_col[1]][i],
+                                 cols.col[slot_col[2]][i]};
+            for (int r = 0; r < n_ranks; r++) {
+                if (!_in_box(boxes + 6*r, x))
+                    continue;
+                for (int j = 0; j < stride; j++)
+                    send[pos[r] + j] = cols.col[slot_col[j]][i];
+                pos[r] += stride;
+            }
+        }
+    }
+    profile_columns_free(&cols);
+    BFT_FREE(boxes);
+
+    double *recv = send;
+    size_t n_recv = (size_t)count[0];
+#if defined(HAVE_MPI)
+    if (n_ranks > 1) {
+        int *r_count = shift + n_ranks, *r_shift = shift + 2*n_ranks;
+        MPI_Alltoall(count, 1, MPI_INT, r_count, 1, MPI_INT, cs_glob_mpi_comm);
+        r_shift[0] = 0;
+        for (int r = 1; r < n_ranks; r++)
+            r_shift[r] = r_shift[r-1] + r_count[r-1];
+        n_recv = (size_t)r_shift[n_ranks-1] + r_count[n_ranks-1];
+        BFT_MALLOC(recv, n_recv + 1, double);
+        MPI_Alltoallv(send, count, shift, MPI_DOUBLE,
+                      recv, r_count, r_shift, MPI_DOUBLE, cs_glob_mpi_comm);
+        BFT_FREE(send);
+    }
+#endif
+    BFT_FREE(count);
+
+    vi->n_points = n_recv/stride;
+    BFT_MALLOC(vi->xyz, 3*vi->n_points + 1, double);
+    BFT_MALLOC(vi->vals, n_vals*vi->n_points + 1, double);
+    for (size_t i = 0; i < vi->n_points; i++) {
+        memcpy(vi->xyz + 3*i, recv + stride*i, 3*sizeof(double));
+        memcpy(vi->vals + n_vals*i, recv + stride*i + 3, n_vals*sizeof(double));
+    }
+    BFT_FREE(recv);
+
+    if (vi->n_points == 0 && n_cells > 0) {
+        bft_printf("Volume initialization: no point of \"%s\" in the"
+                   " partition bounding box of rank %d.\n", fName, rank);
+        volume_init_free(vi);
+        return EXIT_FAILURE;
+    }
+
+    /* k-d tree, then donor points stored in tree order */
+    const size_t n = vi->n_points;
+    size_t *perm;
+    double *xyz, *vals;
+
+    BFT_MALLOC(perm, n, size_t);
+    for (size_t i = 0; i < n; i++)
+        perm[i] = i;
+    BFT_MALLOC(vi->nodes, 4*(n/VOLUME_INIT_LEAF) + 4, struct volume_init_node_t);
+    _build_tree(vi, perm, 0, n);
+
+    BFT_MALLOC(xyz, 3*n, double);
+    BFT_MALLOC(vals, n_vals*n, double);
+    for (size_t i = 0; i < n; i++) {
+        memcpy(xyz + 3*i, vi->xyz + 3*perm[i], 3*sizeof(double));
+        memcpy(vals + n_vals*i, vi->vals + n_vals*perm[i], n_vals*sizeof(double));
+    }
+    BFT_FREE(vi->xyz);
+    BFT_FREE(vi->vals);
+    BFT_FREE(perm);
+    vi->xyz = xyz;
+    vi->vals = vals;
+
+    bft_printf("Volume initialization: %lu donor points from \"%s\""
+               " (%d tree nodes).\n", (unsigned long)n, fName, vi->n_nodes);
+    return EXIT_SUCCESS;
+}
+
+
+int volume_init_apply(const struct volume_init_t* vi)
+{
+    const cs_lnum_t n_cells = cs_glob_mesh->n_cells;
+    const cs_real_t *cell_cen = cs_glob_mesh_quantities->cell_cen;
+    const int n_vals = vi->n_vals;
+
+    if (vi->n_points == 0 && n_cells > 0)
+        return EXIT_FAILURE;
+    if (n_vals != ((cs_glob_turb_model->itytur == 3) ? 10 : 5))
+        return EXIT_FAILURE;
+
+    cs_real_t *vel = CS_F_(u)->val;
+    cs_real_t *eps = CS_F_(eps)->val;
+    cs_real_t *turb = (n_vals == 10) ? CS_F_(rij)->val : CS_F_(k)->val;
+    const int turb_dim = n_vals - 4;
+
+    #pragma omp parallel for schedule(dynamic, VOLUME_INIT_BATCH)
+    for (cs_lnum_t c = 0; c < n_cells; c++) {
+        struct _knn_t r;
+        double v[VOLUME_INIT_MAX_VALS] = {0.};
+        double w[VOLUME_INIT_K];
+        double w_sum = 0.;
+
+        r.n = 0;
+        _search(vi, 0, cell_cen + 3*c, &r);
+
+        /* Inverse distance weights (exact value on a donor point) */
+        for (int i = 0; i < r.n; i++) {
+            w[i] = (r.d2[0] < 1.e-24) ? ((i == 0) ? 1. : 0.) : 1./r.d2[i];
+            w_sum += w[i];
+        }
+        for (int i = 0; i < r.n; i++) {
+            const double *d = vi->vals + n_vals*r.id[i];
+            for (int j = 0; j < n_vals; j++)
+                v[j] += w[i]/w_sum*d[j];
+        }
+
+        for (int j = 0; j < 3; j++)
+            vel[3*c + j] = v[j];
+        for (int j = 0; j < turb_dim; j++)
+            turb[turb_dim*c + j] = v[3 + j];
+        eps[c] = v[n_vals-1];
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+void volume_init_free(struct volume_init_t* vi)
+{
+    BFT_FREE(vi->xyz);
+    BFT_FREE(vi->vals);
+    BFT_FREE(vi->nodes);
+    vi->n_points = 0;
+    vi->n_nodes = 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
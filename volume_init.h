@@ -0,0 +1,63 @@
+#ifndef VOLUME_INIT_H
+#define VOLUME_INIT_H
+
+#include "cs_defs.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VOLUME_INIT_K 8             /* donor points per interpolated cell */
+#define VOLUME_INIT_LEAF 16         /* donor points per k-d tree leaf */
+
+/* k-d tree node, covering donor points [start, end) */
+struct volume_init_node_t {
+    size_t start, end;
+    int dim;                        /* split direction, -1 for a leaf */
+    double split;
+    int child[2];
+};
+
+/**
+* Donor points of a coarse 3D solution overlapping the local partition,
+* sorted along a k-d tree.
+* Values are u, v, w then k, eps (itytur = 2) or rxx, ryy, rzz, rxy, ryz,
+* rxz, eps (itytur = 3).
+*/
+struct volume_init_t {
+    size_t n_points;
+    int n_vals;
+    double *xyz;                    /* n_points x 3 */
+    double *vals;                   /* n_points x n_vals */
+    int n_nodes;
+    struct volume_init_node_t *nodes;
+};
+
+
+/**
+* Load a CSV donor file (header with x, y, z, u, v, w, k, eps or
+* rxx..rxz, eps columns, ParaView names such as "Points:0" or "U:0" are
+* accepted) and build the k-d tree of the points in the bounding box of
+* the local cell centres enlarged by margin.
+* Each rank reads one byte range of the file (profile_columns_read_csv_part())
+* and sends its points to the ranks whose enlarged boxes hold them.
+* Collective; the return value is the same on all ranks except when a
+* box holds no point.
+*/
+int volume_init_load(const char *fName, double margin, struct volume_init_t* vi);
+
+/**
+* Interpolate the donor solution (inverse squared distance weighting of
+* the VOLUME_INIT_K closest points, as the wake probes) on all local cells: velocity, then k, eps
+* or Rij, eps. Cells are processed by batches shared by the OpenMP threads.
+*/
+int volume_init_apply(const struct volume_init_t* vi);
+
+void volume_init_free(struct volume_init_t* vi);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // VOLUME_INIT_H
@@ -0,0 +1,502 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "cs_defs.h"
+
+#include "bft_mem.h"
+#include "bft_error.h"
+#include "bft_printf.h"
+
+#include "cs_field.h"
+#include "cs_field_pointer.h"
+#include "cs_mesh.h"
+#include "cs_mesh_quantities.h"
+#include "cs_time_step.h"
+#include "cs_turbulence_model.h"
+
+#include "wake_probes.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct _probe_set_t {
+    char name[64];
+    int n_points;
+    cs_lnum_t start;            /* index of the first point in the global list */
+    cs_real_t *coords;
+    FILE *f;                    /* output (rank 0) */
+};
+
+/* Distance to the closest local cell center, for MPI_MINLOC */
+struct _probe_dist_t {
+    double d;
+    int rank;
+};
+
+/* Uniform 3D bucket grid over the local cell centers */
+struct _cell_grid_t {
+    int n[3];
+    cs_real_t min[3], h[3];
+    cs_lnum_t *start;
+    cs_lnum_t *items;
+};
+
+static struct _probe_set_t _sets[WAKE_PROBES_MAX_SETS];
+static int _n_sets = 0;
+static cs_lnum_t _n_probes = 0;
+
+/* Location: probes owned by this rank and their interpolation stencil */
+static int _located = 0;
+static const cs_real_t *_loc_cell_cen = NULL;
+static cs_lnum_t _loc_n_cells = -1;
+static cs_lnum_t _n_owned = 0;
+static cs_lnum_t *_owned_ids = NULL;
+static cs_lnum_t *_owned_cells = NULL;     /* _n_owned x WAKE_PROBES_K, -1 if unused */
+static cs_real_t *_owned_w = NULL;         /* _n_owned x WAKE_PROBES_K */
+static int *_probe_out = NULL;             /* _n_probes, 1 outside the mesh */
+
+static cs_real_t *_buf = NULL;             /* _n_probes x n_vals */
+static int _buf_vals = 0;
+
+
+static void
+_cell_grid_build(cs_lnum_t n, const cs_real_t *xyz, struct _cell_grid_t* g)
+{
+    cs_real_t max[3];
+    int n_side = (int)cbrt((double)n/4.) + 1;
+
+    for (int j = 0; j < 3; j++) {
+        g->min[j] = HUGE_VAL;
+        max[j] = -HUGE_VAL;
+    }
+    for (cs_lnum_t i = 0; i < n; i++)
+        for (int j = 0; j < 3; j++) {
+            g->min[j] = CS_MIN(g->min[j], xyz[3*i+j]);
+            max[j] = CS_MAX(max[j], xyz[3*i+j]);
+        }
+    for (int j = 0; j < 3; j++) {
+        g->n[j] = n_side;
+        g->h[j] = (max[j] - g->min[j])/n_side;
+        if (g->h[j] <= 0.)
+            g->h[j] = 1.;
+    }
+
+    const cs_lnum_t n_bins = (cs_lnum_t)g->n[0]*g->n[1]*g->n[2];
+    cs_lnum_t *bin_id, *pos;
+    BFT_MALLOC(g->start, n_bins + 1, cs_lnum_t);
+    BFT_MALLOC(g->items, n, cs_lnum_t);
+    BFT_MALLOC(bin_id, n, cs_lnum_t);
+    memset(g->start, 0, (n_bins + 1)*sizeof(cs_lnum_t));
+
+    for (cs_lnum_t i = 0; i < n; i++) {
+        int b[3];
+        for (int j = 0; j < 3; j++) {
+            b[j] = (int)((xyz[3*i+j] - g->min[j])/g->h[j]);
+            b[j] = CS_MIN(CS_MAX(b[j], 0), g->n[j] - 1);
+        }
+        bin_id[i] = ((cs_lnum_t)b[2]*g->n[1] + b[1])*g->n[0] + b[0];
+        g->start[bin_id[i] + 1] += 1;
+    }
+    for (cs_lnum_t b = 0; b < n_bins; b++)
+        g->start[b+1] += g->start[b];
+
+    BFT_MALLOC(pos, n_bins, cs_lnum_t);
+    memcpy(pos, g->start, n_bins*sizeof(cs_lnum_t));
+    for (cs_lnum_t i = 0; i < n; i++)
+        g->items[pos[bin_id[i]]++] = i;
+
+    BFT_FREE(pos);
+    BFT_FREE(bin_id);
+}
+
+/* WAKE_PROBES_K closest cells to q (sorted), returns the number found */
+static int
+_cell_grid_knn(const struct _cell_grid_t* g, const cs_real_t *xyz,
+               const cs_real_t q[3], cs_lnum_t ids[], cs_real_t d2[])
+{
+    int c[3], n_found = 0;
+    int r_max = CS_MAX(g->n[0], CS_MAX(g->n[1], g->n[2]));
+    cs_real_t h_min = CS_MIN(g->h[0], CS_MIN(g->h[1], g->h[2]));
+
+    for (int j = 0; j < 3; j++) {
+        c[j] = (int)((q[j] - g->min[j])/g->h[j]);
+        c[j] = CS_MIN(CS_MAX(c[j], 0), g->n[j] - 1);
+    }
+
+    for (int r = 0; r <= r_max; r++) {
+        for (int k = c[2] - r; k <= c[2] + r; k++) {
+            if (k < 0 || k >= g->n[2]) continue;
+            for (int j = c[1] - r; j <= c[1] + r; j++) {
+                if (j < 0 || j >= g->n[1]) continue;
+                for (int i = c[0] - r; i <= c[0] + r; i++) {
+                    if (i < 0 || i >= g->n[0]) continue;
+                    if (   CS_ABS(i - c[0]) != r && CS_ABS(j - c[1]) != r
+                        && CS_ABS(k - c[2]) != r) continue;
+                    cs_lnum_t b = ((cs_lnum_t)k*g->n[1] + j)*g->n[0] + i;
+                    for (cs_lnum_t l = g->start[b]; l < g->start[b+1]; l++) {
+                        cs_lnum_t id = g->items[l];
+                        cs_real_t d = 0.;
+                        for (int m = 0; m < 3; m++)
+                            d += (xyz[3*id+m] - q[m])*(xyz[3*id+m] - q[m]);
+                        if (n_found == WAKE_PROBES_K && d >= d2[n_found-1])
+                            continue;
+                        /* insertion in the sorted list */
+                        int p = (n_found < WAKE_PROBES_K) ? n_found++ : n_found - 1;
+                        while (p > 0 && d2[p-1] > d) {
+                            d2[p] = d2[p-1];
+                            ids[p] = ids[p-1];
+                            p--;
+                        }
+                        d2[p] = d;
+                        ids[p] = id;
+                    }
+                }
+            }
+        }
+        if (n_found == WAKE_PROBES_K && d2[n_found-1] <= (r*h_min)*(r*h_min))
+            break;
+    }
+    return n_found;
+}
+
+static int
+_add_set(const char *name, int n_points)
+{
+    if (_n_sets >= WAKE_PROBES_MAX_SETS)
+        bft_error(__FILE__, __LINE__, 0,
+                  "Too many probe sets (max %d).\n", WAKE_PROBES_MAX_SETS);
+
+    struct _probe_set_t *s = _sets + _n_sets;
+    memset(s, 0, sizeof(struct _probe_set_t));
+    strncpy(s->name, name, sizeof(s->name) - 1);
+    s->n_points = n_points;
+    s->start = _n_probes;
+    BFT_MALLOC(s->coords, 3*n_points, cs_real_t);
+
+    _n_probes += n_points;
+    _located = 0;
+    return _n_sets++;
+}
+
+static void
+_locate(void)
+{
+    const cs_mesh_t *m = cs_glob_mesh;
+    const cs_real_t *cell_cen = cs_glob_mesh_quantities->cell_cen;
+    const cs_real_t *cell_vol = cs_glob_mesh_quantities->cell_vol;
+    struct _cell_grid_t grid;
+    cs_lnum_t *ids;
+    cs_real_t *w, *h2;
+    struct _probe_dist_t *d_min;
+
+    BFT_FREE(_owned_ids);
+    BFT_FREE(_owned_cells);
+    BFT_FREE(_owned_w);
+
+    BFT_MALLOC(ids, _n_probes*WAKE_PROBES_K, cs_lnum_t);
+    BFT_MALLOC(w, _n_probes*WAKE_PROBES_K, cs_real_t);
+    BFT_MALLOC(h2, _n_probes, cs_real_t);
+    BFT_MALLOC(d_min, _n_probes, struct _probe_dist_t);
+    BFT_REALLOC(_probe_out, _n_probes, int);
+
+    if (m->n_cells > 0)
+        _cell_grid_build(m->n_cells, cell_cen, &grid);
+
+    for (int s_id = 0; s_id < _n_sets; s_id++) {
+        const struct _probe_set_t *s = _sets + s_id;
+        for (int p = 0; p < s->n_points; p++) {
+            cs_lnum_t g_id = s->start + p;
+            cs_lnum_t *pi = ids + g_id*WAKE_PROBES_K;
+            cs_real_t *pw = w + g_id*WAKE_PROBES_K;
+            cs_real_t d2[WAKE_PROBES_K];
+            int n = 0;
+
+            if (m->n_cells > 0)
+                n = _cell_grid_knn(&grid, cell_cen, s->coords + 3*p, pi, d2);
+
+            /* Inverse squared distance weights, as volume_init_apply()
+               (exact value on a cell center) */
+            cs_real_t w_sum = 0.;
+            for (int k = 0; k < WAKE_PROBES_K; k++) {
+                if (k >= n) {
+                    pi[k] = -1;
+                    pw[k] = 0.;
+                    continue;
+                }
+                pw[k] = (d2[0] < 1.e-24) ? ((k == 0) ? 1. : 0.) : 1./d2[k];
+                w_sum += pw[k];
+            }
+            for (int k = 0; k < n; k++)
+                pw[k] /= w_sum;
+
+            /* Squared distance beyond which the probe is outside the mesh */
+            if (n > 0) {
+                const cs_real_t h = WAKE_PROBES_MAX_DIST*cbrt(cell_vol[pi[0]]);
+                h2[g_id] = h*h;
+            }
+            d_min[g_id].d = (n > 0) ? d2[0] : HUGE_VAL;
+            d_min[g_id].rank = cs_glob_rank_id < 0 ? 0 : cs_glob_rank_id;
+        }
+    }
+
+    if (m->n_cells > 0) {
+        BFT_FREE(grid.start);
+        BFT_FREE(grid.items);
+    }
+
+    /* Each probe belongs to the rank holding the closest cell center */
+#if defined(HAVE_MPI)
+    if (cs_glob_n_ranks > 1)
+        MPI_Allreduce(MPI_IN_PLACE, d_min, _n_probes, MPI_DOUBLE_INT, MPI_MINLOC,
+                      cs_glob_mpi_comm);
+#endif
+
+    /* Probes too far from the closest cell center are outside the mesh:
+       not interpolated, written as nan */
+    const int rank = CS_MAX(cs_glob_rank_id, 0);
+    for (cs_lnum_t g_id = 0; g_id < _n_probes; g_id++) {
+        _probe_out[g_id] = 0;
+        if (d_min[g_id].d == HUGE_VAL)
+            _probe_out[g_id] = 1;
+        else if (d_min[g_id].rank == rank && d_min[g_id].d > h2[g_id])
+            _probe_out[g_id] = 1;
+    }
+#if defined(HAVE_MPI)
+    if (cs_glob_n_ranks > 1)
+        MPI_Allreduce(MPI_IN_PLACE, _probe_out, _n_probes, MPI_INT, MPI_MAX,
+                      cs_glob_mpi_comm);
+#endif
+    {
+        cs_lnum_t n_out = 0;
+        for (cs_lnum_t g_id = 0; g_id < _n_probes; g_id++)
+            n_out += _probe_out[g_id];
+        if (n_out > 0)
+            bft_printf("Wake probes: %ld of %ld probes outside the mesh, dropped.\n",
+                       (long)n_out, (long)_n_probes);
+    }
+
+    _n_owned = 0;
+    for (cs_lnum_t g_id = 0; g_id < _n_probes; g_id++)
+        if (d_min[g_id].rank == rank && !_probe_out[g_id])
+            _n_owned++;
+
+    BFT_MALLOC(_owned_ids, _n_owned, cs_lnum_t);
+    BFT_MALLOC(_owned_cells, _n_owned*WAKE_PROBES_K, cs_lnum_t);
+    BFT_MALLOC(_owned_w, _n_owned*WAKE_PROBES_K, cs_real_t);
+
+    _n_owned = 0;
+    for (cs_lnum_t g_id = 0; g_id < _n_probes; g_id++) {
+        if (d_min[g_id].rank == rank && !_probe_out[g_id]) {
+            _owned_ids[_n_owned] = g_id;
+            for (int k = 0; k < WAKE_PROBES_K; k++) {
+                _owned_cells[_n_owned*WAKE_PROBES_K + k] = ids[g_id*WAKE_PROBES_K + k];
+                _owned_w[_n_owned*WAKE_PROBES_K + k] = w[g_id*WAKE_PROBES_K + k];
+            }
+            _n_owned++;
+        }
+    }
+
+    BFT_FREE(d_min);
+    BFT_FREE(h2);
+    BFT_FREE(w);
+    BFT_FREE(ids);
+
+    _loc_cell_cen = cell_cen;
+    _loc_n_cells = m->n_cells;
+    _located = 1;
+}
+
+/* Sampled fields: velocity, then k and eps or Rij and eps */
+static int
+_sampled_fields(const cs_field_t *fields[3])
+{
+    int n_fields = 0;
+    fields[n_fields++] = CS_F_(u);
+    if (cs_glob_turb_model->itytur == 2) {
+        fields[n_fields++] = CS_F_(k);
+        fields[n_fields++] = CS_F_(eps);
+    }
+    else if (cs_glob_turb_model->itytur == 3) {
+        fields[n_fields++] = CS_F_(rij);
+        fields[n_fields++] = CS_F_(eps);
+    }
+    return n_fields;
+}
+
+static void
+_write_header(struct _probe_set_t* s, const cs_field_t *fields[], int n_fields)
+{
+    char fName[128];
+    snprintf(fName, sizeof(fName), "probes_%s.dat", s->name);
+
+    /* A restarted run continues the history of the previous one */
+    s->f = fopen(fName, (cs_glob_time_step->nt_prev > 0) ? "a" : "w");
+    if (s->f == NULL)
+        bft_error(__FILE__, __LINE__, 0, "Cannot open \"%s\".\n", fName);
+    fseek(s->f, 0, SEEK_END);
+    if (ftell(s->f) > 0)
+        return;
+
+    fprintf(s->f, "# probe set %s, %d points\n", s->name, s->n_points);
+    for (int p = 0; p < s->n_points; p++)
+        fprintf(s->f, "# point %d: %.8e %.8e %.8e%s\n", p,
+                s->coords[3*p], s->coords[3*p+1], s->coords[3*p+2],
+                _probe_out[s->start + p] ? " (outside the mesh)" : "");
+    fprintf(s->f, "# t, then for each point:");
+    for (int f_id = 0; f_id < n_fields; f_id++)
+        fprintf(s->f, " %s[%d]", fields[f_id]->name, fields[f_id]->dim);
+    fprintf(s->f, "\n");
+}
+
+
+int wake_probes_add_line(const char *name,
+                         const cs_real_t a[3],
+                         const cs_real_t b[3],
+                         int n_points)
+{
+    int s_id = _add_set(name, n_points);
+    cs_real_t *x = _sets[s_id].coords;
+
+    for (int p = 0; p < n_points; p++) {
+        cs_real_t t = (n_points > 1) ? (cs_real_t)p/(n_points - 1) : 0.;
+        for (int j = 0; j < 3; j++)
+            x[3*p+j] = a[j] + t*(b[j] - a[j]);
+    }
+    return s_id;
+}
+
+
+int wake_probes_add_plane(const char *name,
+                          const cs_real_t origin[3],
+                          const cs_real_t e1[3],
+                          const cs_real_t e2[3],
+                          int n1,
+                          int n2)
+{
+    int s_id = _add_set(name, n1*n2);
+    cs_real_t *x = _sets[s_id].coords;
+
+    for (int j2 = 0; j2 < n2; j2++) {
+        cs_real_t t2 = (n2 > 1) ? (cs_real_t)j2/(n2 - 1) : 0.;
+        for (int j1 = 0; j1 < n1; j1++) {
+            cs_real_t t1 = (n1 > 1) ? (cs_real_t)j1/(n1 - 1) : 0.;
+            cs_lnum_t p = (cs_lnum_t)j2*n1 + j1;
+            for (int j = 0; j < 3; j++)
+                x[3*p+j] = origin[j] + t1*e1[j] + t2*e2[j];
+        }
+    }
+    return s_id;
+}
+
+
+void wake_probes_relocate(void)
+{
+    _located = 0;
+}
+
+
+void wake_probes_sample(int interval)
+{
+    const cs_time_step_t *ts = cs_glob_time_step;
+    const cs_field_t *fields[3];
+    int n_fields, n_vals = 0;
+
+    if (_n_probes == 0 || interval <= 0 || ts->nt_cur % interval != 0)
+        return;
+
+    /* (Re)locate after a mesh change on any rank: _locate() is collective */
+    int relocate = (   !_located
+                    || _loc_cell_cen != cs_glob_mesh_quantities->cell_cen
+                    || _loc_n_cells != cs_glob_mesh->n_cells);
+#if defined(HAVE_MPI)
+    if (cs_glob_n_ranks > 1)
+        MPI_Allreduce(MPI_IN_PLACE, &relocate, 1, MPI_INT, MPI_MAX, cs_glob_mpi_comm);
+#endif
+    if (relocate)
+        _locate();
+
+    n_fields = _sampled_fields(fields);
+    for (int f_id = 0; f_id < n_fields; f_id++)
+        n_vals += fields[f_id]->dim;
+
+    if (n_vals != _buf_vals) {
+        BFT_REALLOC(_buf, _n_probes*n_vals, cs_real_t);
+        _buf_vals = n_vals;
+    }
+    memset(_buf, 0, _n_probes*n_vals*sizeof(cs_real_t));
+
+    /* Interpolation at the owned probes: O(n_probes) */
+    for (cs_lnum_t i = 0; i < _n_owned; i++) {
+        const cs_lnum_t *c = _owned_cells + i*WAKE_PROBES_K;
+        const cs_real_t *w = _owned_w + i*WAKE_PROBES_K;
+        cs_real_t *v = _buf + _owned_ids[i]*n_vals;
+        for (int f_id = 0; f_id < n_fields; f_id++) {
+            const int dim = fields[f_id]->dim;
+            const cs_real_t *val = fields[f_id]->val;
+            for (int k = 0; k < WAKE_PROBES_K && c[k] > -1; k++)
+                for (int j = 0; j < dim; j++)
+                    v[j] += w[k]*val[c[k]*dim + j];
+            v += dim;
+        }
+    }
+
+    /* One compact reduction to the writer rank */
+#if defined(HAVE_MPI)
+    if (cs_glob_n_ranks > 1) {
+        if (cs_glob_rank_id == 0)
+            MPI_Reduce(MPI_IN_PLACE, _buf, _n_probes*n_vals, CS_MPI_REAL, MPI_SUM, 0,
+                       cs_glob_mpi_comm);
+        else
+            MPI_Reduce(_buf, NULL, _n_probes*n_vals, CS_MPI_REAL, MPI_SUM, 0,
+                       cs_glob_mpi_comm);
+    }
+#endif
+
+    if (cs_glob_rank_id > 0)
+        return;
+
+    for (int s_id = 0; s_id < _n_sets; s_id++) {
+        struct _probe_set_t *s = _sets + s_id;
+        const cs_real_t *v = _buf + s->start*n_vals;
+        if (s->f == NULL)
+            _write_header(s, fields, n_fields);
+        fprintf(s->f, "%.8e", ts->t_cur);
+        for (cs_lnum_t i = 0; i < (cs_lnum_t)s->n_points*n_vals; i++) {
+            if (_probe_out[s->start + i/n_vals])
+                fprintf(s->f, " nan");
+            else
+                fprintf(s->f, " %.6e", v[i]);
+        }
+        fprintf(s->f, "\n");
+        fflush(s->f);
+    }
+}
+
+
+void wake_probes_finalize(void)
+{
+    for (int s_id = 0; s_id < _n_sets; s_id++) {
+        if (_sets[s_id].f != NULL)
+            fclose(_sets[s_id].f);
+        BFT_FREE(_sets[s_id].coords);
+    }
+    _n_sets = 0;
+    _n_probes = 0;
+
+    BFT_FREE(_owned_ids);
+    BFT_FREE(_owned_cells);
+    BFT_FREE(_owned_w);
+    BFT_FREE(_probe_out);
+    BFT_FREE(_buf);
+    _buf_vals = 0;
+    _n_owned = 0;
+    _located = 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,58 @@
+#ifndef WAKE_PROBES_H
+#define WAKE_PROBES_H
+
+#include "cs_defs.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WAKE_PROBES_MAX_SETS 16
+#define WAKE_PROBES_K 4         /* cells used to interpolate each probe (1/d^2) */
+#define WAKE_PROBES_MAX_DIST 2. /* in cell sizes (cube root of the volume) from the
+                                   closest cell center, beyond: outside the mesh */
+
+
+/**
+* Sampling line from a to b with n_points points (end points included).
+* Returns the set id.
+*/
+int wake_probes_add_line(const char *name,
+                         const cs_real_t a[3],
+                         const cs_real_t b[3],
+                         int n_points);
+
+/**
+* Sampling plane: origin + i/(n1-1) e1 + j/(n2-1) e2, n1 x n2 points.
+* Returns the set id.
+*/
+int wake_probes_add_plane(const char *name,
+                          const cs_real_t origin[3],
+                          const cs_real_t e1[3],
+                          const cs_real_t e2[3],
+                          int n1,
+                          int n2);
+
+/**
+* Force a new location of the probes (done automatically when the
+* local mesh changes).
+*/
+void wake_probes_relocate(void);
+
+/**
+* Sample velocity and turbulence (k, eps or Rij, eps) at all probes every
+* "interval" time steps; values are reduced to rank 0 which appends
+* them to probes_<name>.dat (continued, not truncated, on a restarted run).
+* Probes farther than WAKE_PROBES_MAX_DIST cell sizes from the closest
+* cell center are outside the mesh: they are logged at location and written as nan.
+*/
+void wake_probes_sample(int interval);
+
+void wake_probes_finalize(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WAKE_PROBES_H